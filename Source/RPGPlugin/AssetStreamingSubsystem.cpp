@@ -0,0 +1,92 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AssetStreamingSubsystem.h"
+
+void UAssetStreamingSubsystem::Deinitialize()
+{
+	PendingCallbacks.Empty();
+	ReleaseCachedAssets();
+
+	Super::Deinitialize();
+}
+
+void UAssetStreamingSubsystem::RequestAsset(const FSoftObjectPath& AssetPath, FStreamableDelegate OnLoaded)
+{
+	if (AssetPath.IsNull()) return;
+
+	const TSharedPtr<FStreamableHandle>* CachedHandle = CachedHandles.Find(AssetPath);
+
+	if ((CachedHandle != nullptr) && (*CachedHandle).IsValid() && (*CachedHandle)->HasLoadCompleted())
+	{
+		OnLoaded.ExecuteIfBound();
+		return;
+	}
+
+	// Already streaming, wait for the same handle
+	if (TArray<FStreamableDelegate>* Callbacks = PendingCallbacks.Find(AssetPath))
+	{
+		Callbacks->Add(OnLoaded);
+		return;
+	}
+
+	// Register before the request, the manager may complete it right away
+	PendingCallbacks.Add(AssetPath).Add(OnLoaded);
+
+	TSharedPtr<FStreamableHandle> Handle = StreamableManager.RequestAsyncLoad(AssetPath,
+		FStreamableDelegate::CreateUObject(this, &UAssetStreamingSubsystem::OnAssetLoaded, AssetPath));
+
+	if (Handle.IsValid())
+	{
+		CachedHandles.Add(AssetPath, Handle);
+	}
+	else
+	{
+		// Invalid path, nothing will be loaded
+		PendingCallbacks.Remove(AssetPath);
+		UE_LOG(LogTemp, Warning, TEXT("[UAssetStreamingSubsystem::RequestAsset] Unable to stream %s"), *AssetPath.ToString());
+	}
+}
+
+void UAssetStreamingSubsystem::OnAssetLoaded(FSoftObjectPath AssetPath)
+{
+	TArray<FStreamableDelegate> Callbacks;
+	if (!PendingCallbacks.RemoveAndCopyValue(AssetPath, Callbacks)) return;
+
+	for (FStreamableDelegate& Callback : Callbacks)
+	{
+		Callback.ExecuteIfBound();
+	}
+}
+
+void UAssetStreamingSubsystem::PrefetchItem(const FItem& Item)
+{
+	RequestAsset(Item.ItemIcon.ToSoftObjectPath());
+	RequestAsset(Item.ItemActor.ToSoftObjectPath());
+}
+
+void UAssetStreamingSubsystem::PrefetchQuest(const FQuest& Quest)
+{
+	RequestAsset(Quest.ItemQuestTexture.ToSoftObjectPath());
+}
+
+bool UAssetStreamingSubsystem::IsAssetLoaded(const FSoftObjectPath& AssetPath) const
+{
+	return AssetPath.ResolveObject() != nullptr;
+}
+
+void UAssetStreamingSubsystem::ReleaseCachedAssets()
+{
+	for (auto It = CachedHandles.CreateIterator(); It; ++It)
+	{
+		// Keep the handles still loading, their callbacks are waiting
+		if (PendingCallbacks.Contains(It.Key())) continue;
+
+		if (It.Value().IsValid())
+		{
+			It.Value()->ReleaseHandle();
+		}
+
+		It.RemoveCurrent();
+	}
+}
@@ -0,0 +1,48 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/GameInstanceSubsystem.h"
+#include "Engine/StreamableManager.h"
+#include "ItemData.h"
+#include "AssetStreamingSubsystem.generated.h"
+
+/**
+ * Loads the soft referenced quest/item assets on demand.
+ * Handles are cached by path so an asset requested again is not streamed twice and stays in memory.
+ */
+UCLASS()
+class RPGPLUGIN_API UAssetStreamingSubsystem : public UGameInstanceSubsystem
+{
+	GENERATED_BODY()
+
+public:
+
+	virtual void Deinitialize() override;
+
+	// Calls OnLoaded once the asset is in memory, right away if it is already loaded
+	void RequestAsset(const FSoftObjectPath& AssetPath, FStreamableDelegate OnLoaded = FStreamableDelegate());
+
+	// Starts streaming the icon and the actor class of the item
+	void PrefetchItem(const FItem& Item);
+
+	// Starts streaming the texture shown on the quest popup
+	void PrefetchQuest(const FQuest& Quest);
+
+	bool IsAssetLoaded(const FSoftObjectPath& AssetPath) const;
+
+	// Drops every cached handle, assets not referenced anywhere else can be collected
+	UFUNCTION(BlueprintCallable, Category = "Streaming")
+		void ReleaseCachedAssets();
+
+protected:
+
+	void OnAssetLoaded(FSoftObjectPath AssetPath);
+
+	FStreamableManager StreamableManager;
+
+	TMap<FSoftObjectPath, TSharedPtr<FStreamableHandle>> CachedHandles;
+
+	TMap<FSoftObjectPath, TArray<FStreamableDelegate>> PendingCallbacks;
+};
@@ -4,6 +4,9 @@
 #include "BasicInteractive.h"
 #include "Components/BoxComponent.h"
 #include "RPGPluginCharacter.h"
+#include "WorldStateSubsystem.h"
+#include "InteractionGridSubsystem.h"
+#include "TickSignificanceSubsystem.h"
 
 // Sets default values
 ABasicInteractive::ABasicInteractive()
@@ -27,11 +30,99 @@ void ABasicInteractive::BeginPlay()
 {
 	Super::BeginPlay();
 
+	UInteractionGridSubsystem* InteractionGrid = bUseInteractionGrid ? GetWorld()->GetSubsystem<UInteractionGridSubsystem>() : nullptr;
+
+	if (InteractionGrid != nullptr)
+	{
+		// The box is only read once, the physics scene doesn't keep it updated anymore
+		Trigger->SetGenerateOverlapEvents(false);
+		Trigger->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+
+		InteractionGridHandle = InteractionGrid->RegisterInteractive(this, Trigger->GetComponentTransform(), Trigger->GetScaledBoxExtent());
+	}
+
+	// Only actors that tick at all are worth managing
+	if (PrimaryActorTick.bCanEverTick)
+	{
+		TickSignificance = GetWorld()->GetSubsystem<UTickSignificanceSubsystem>();
+
+		if (TickSignificance != nullptr)
+		{
+			TickSignificance->RegisterActor(this);
+		}
+	}
+
+	UWorldStateSubsystem* WorldState = GetGameInstance()->GetSubsystem<UWorldStateSubsystem>();
+	WorldStateIndex = (WorldState != nullptr) ? WorldState->RegisterActor(this) : INDEX_NONE;
+
+	if (WorldStateIndex != INDEX_NONE)
+	{
+		// Loading or loading again replaces the flags
+		WorldStateLoadedHandle = WorldState->OnWorldStateLoaded.AddUObject(this, &ABasicInteractive::OnWorldStateLoaded);
+
+		if (WorldState->IsLoaded())
+		{
+			ApplyPersistentFlag(WorldState->GetFlag(WorldStateIndex));
+		}
+	}
+}
+
+void ABasicInteractive::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	UWorldStateSubsystem* WorldState = GetGameInstance()->GetSubsystem<UWorldStateSubsystem>();
+
+	if ((WorldState != nullptr) && WorldStateLoadedHandle.IsValid())
+	{
+		WorldState->OnWorldStateLoaded.Remove(WorldStateLoadedHandle);
+		WorldStateLoadedHandle.Reset();
+	}
+
+	UInteractionGridSubsystem* InteractionGrid = GetWorld()->GetSubsystem<UInteractionGridSubsystem>();
+
+	if ((InteractionGrid != nullptr) && (InteractionGridHandle != INDEX_NONE))
+	{
+		InteractionGrid->UnregisterInteractive(InteractionGridHandle);
+		InteractionGridHandle = INDEX_NONE;
+	}
+
+	if (TickSignificance != nullptr)
+	{
+		TickSignificance->UnregisterActor(this);
+		TickSignificance = nullptr;
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+bool ABasicInteractive::GetPersistentFlag() const
+{
+	UWorldStateSubsystem* WorldState = GetGameInstance()->GetSubsystem<UWorldStateSubsystem>();
+	return (WorldState != nullptr) && WorldState->GetFlag(WorldStateIndex);
+}
+
+void ABasicInteractive::SetPersistentFlag(bool bValue)
+{
+	if (UWorldStateSubsystem* WorldState = GetGameInstance()->GetSubsystem<UWorldStateSubsystem>())
+	{
+		WorldState->SetFlag(WorldStateIndex, bValue);
+	}
+}
+
+void ABasicInteractive::ApplyPersistentFlag(bool bFlag)
+{
+	// Nothing to restore here, subclasses with persistent state override it
+}
+
+void ABasicInteractive::OnWorldStateLoaded()
+{
+	ApplyPersistentFlag(GetPersistentFlag());
 }
 
 // Called every frame
 void ABasicInteractive::Tick(float DeltaTime)
 {
+	FSignificanceTickScope SignificanceScope(TickSignificance);
+
 	Super::Tick(DeltaTime);
 
 }
@@ -39,17 +130,23 @@ void ABasicInteractive::Tick(float DeltaTime)
 void ABasicInteractive::BeginOverlap(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor,
 	UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult)
 {
-	PlayerCharacter = Cast<ARPGPluginCharacter>(OtherActor);
+	NotifyPlayerBeginOverlap(Cast<ARPGPluginCharacter>(OtherActor));
+}
 
-	if (PlayerCharacter != nullptr)
-	{
-		PlayerCharacter->OnEnterActor(this);
+void ABasicInteractive::NotifyPlayerBeginOverlap(ARPGPluginCharacter* Character)
+{
+	if ((Character == nullptr) || IsPlayerOverlapping(Character)) return;
 
-		OnPlayerBeginOverlap();
-	}
+	// Players destroyed while inside never sent the end overlap
+	OverlappingPlayers.RemoveAllSwap([](const TWeakObjectPtr<ARPGPluginCharacter>& Player) { return !Player.IsValid(); });
+	OverlappingPlayers.Add(Character);
+
+	Character->OnEnterActor(this);
+
+	OnPlayerBeginOverlap(Character);
 }
 
-void ABasicInteractive::OnPlayerBeginOverlap()
+void ABasicInteractive::OnPlayerBeginOverlap(ARPGPluginCharacter* Player)
 {
 
 }
@@ -58,15 +155,63 @@ void ABasicInteractive::OnPlayerBeginOverlap()
 void ABasicInteractive::EndOverlap(UPrimitiveComponent* OverlappedComp, AActor* OtherActor,
 	UPrimitiveComponent* OtherComp, int32 OtherBodyIndex)
 {
-	if (PlayerCharacter != nullptr)
-	{
-		PlayerCharacter->OnLeaveActor();
+	NotifyPlayerEndOverlap(Cast<ARPGPluginCharacter>(OtherActor));
+}
+
+void ABasicInteractive::NotifyPlayerEndOverlap(ARPGPluginCharacter* Character)
+{
+	// Only the player that actually left
+	if ((Character == nullptr) || (OverlappingPlayers.RemoveSingleSwap(Character) == 0)) return;
+
+	Character->OnLeaveActor(this);
+
+	OnPlayerEndOverlap(Character);
+}
+
+void ABasicInteractive::OnPlayerEndOverlap(ARPGPluginCharacter* Player)
+{
+
+}
 
-		OnPlayerEndOverlap();
+bool ABasicInteractive::IsPlayerOverlapping(const ARPGPluginCharacter* Character) const
+{
+	return OverlappingPlayers.Contains(Character);
+}
+
+bool ABasicInteractive::HasPlayerFocus(const ARPGPluginCharacter* Character) const
+{
+	return FocusingPlayers.Contains(Character);
+}
+
+void ABasicInteractive::NotifyPlayerFocusBegin(ARPGPluginCharacter* Character)
+{
+	if ((Character == nullptr) || HasPlayerFocus(Character)) return;
+
+	FocusingPlayers.RemoveAllSwap([](const TWeakObjectPtr<ARPGPluginCharacter>& Player) { return !Player.IsValid(); });
+	FocusingPlayers.Add(Character);
+	PlayerCharacter = Character;
+
+	OnPlayerFocusBegin(Character);
+}
+
+void ABasicInteractive::NotifyPlayerFocusEnd(ARPGPluginCharacter* Character)
+{
+	if ((Character == nullptr) || (FocusingPlayers.RemoveSingleSwap(Character) == 0)) return;
+
+	if (PlayerCharacter == Character)
+	{
+		PlayerCharacter = (FocusingPlayers.Num() > 0) ? FocusingPlayers.Last().Get() : nullptr;
 	}
+
+	OnPlayerFocusEnd(Character);
+}
+
+void ABasicInteractive::OnPlayerFocusBegin(ARPGPluginCharacter* Player)
+{
+
 }
 
-void ABasicInteractive::OnPlayerEndOverlap()
+void ABasicInteractive::OnPlayerFocusEnd(ARPGPluginCharacter* Player)
 {
 
 }
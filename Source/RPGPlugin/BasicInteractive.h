@@ -7,6 +7,8 @@
 #include "Interactable.h"
 #include "BasicInteractive.generated.h"
 
+class ARPGPluginCharacter;
+
 UCLASS()
 class RPGPLUGIN_API ABasicInteractive : public AActor
 {
@@ -26,7 +28,21 @@ protected:
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Interactive")
 		class UBoxComponent* Trigger;
 
-	class ARPGPluginCharacter* PlayerCharacter;
+	// Player proximity comes from UInteractionGridSubsystem, the trigger only gives the box and has no collision.
+	// Turn off for interactives that move, or that must detect other actors than the players
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Interactive")
+		bool bUseInteractionGrid = true;
+
+	int32 InteractionGridHandle = INDEX_NONE;
+
+	// Player running OnInteract: the one calling ARPGPluginCharacter::Interact, else the last one that got the focus
+	TWeakObjectPtr<class ARPGPluginCharacter> PlayerCharacter;
+
+	// Players inside of the interactive, and those of them that have it as focus.
+	// Inline for split-screen, larger sessions spill to the heap
+	TArray<TWeakObjectPtr<class ARPGPluginCharacter>, TInlineAllocator<4>> OverlappingPlayers;
+
+	TArray<TWeakObjectPtr<class ARPGPluginCharacter>, TInlineAllocator<4>> FocusingPlayers;
 
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Interactive")
 		FName InteractiveName;
@@ -37,22 +53,66 @@ protected:
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Interactive")
 		bool QuestActivated;
 
+	//// Persistent state ///////
+
+	// Flag of this actor on the world state registry, kept on the save
+	bool GetPersistentFlag() const;
+
+	void SetPersistentFlag(bool bValue);
+
+	// Called on BeginPlay with the saved flag, and again if a save is loaded afterwards
+	virtual void ApplyPersistentFlag(bool bFlag);
+
+	void OnWorldStateLoaded();
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	// INDEX_NONE for actors spawned at runtime, they have no stable ID
+	int32 WorldStateIndex = INDEX_NONE;
+
+	FDelegateHandle WorldStateLoadedHandle;
+
+	// Decides how often this actor ticks, see UTickSignificanceSubsystem
+	UPROPERTY(Transient)
+		class UTickSignificanceSubsystem* TickSignificance = nullptr;
+
 public:
 	// Called every frame
 	virtual void Tick(float DeltaTime) override;
 
+	bool IsPlayerOverlapping(const class ARPGPluginCharacter* Character) const;
+
+	bool HasPlayerFocus(const class ARPGPluginCharacter* Character) const;
+
+	void SetInteractingPlayer(class ARPGPluginCharacter* Character) { PlayerCharacter = Character; }
+
+	// Begin/end overlap of a player, from the trigger or from the interaction grid
+	void NotifyPlayerBeginOverlap(class ARPGPluginCharacter* Character);
+
+	void NotifyPlayerEndOverlap(class ARPGPluginCharacter* Character);
+
+	// The player picked this interactive among the ones it overlaps, see ARPGPluginCharacter::UpdateInteractionFocus
+	void NotifyPlayerFocusBegin(class ARPGPluginCharacter* Character);
+
+	void NotifyPlayerFocusEnd(class ARPGPluginCharacter* Character);
+
 protected:
 	UFUNCTION()
 		virtual void BeginOverlap(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor,
 			UPrimitiveComponent* OtherComp, int32 OtherBodyIndex,
 			bool bFromSweep, const FHitResult& SweepResult);
 
-	virtual void OnPlayerBeginOverlap();
+	virtual void OnPlayerBeginOverlap(class ARPGPluginCharacter* Player);
 
 	UFUNCTION()
 		virtual void EndOverlap(UPrimitiveComponent* OverlappedComp,
 			AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex);
 
-	virtual void OnPlayerEndOverlap();
+	virtual void OnPlayerEndOverlap(class ARPGPluginCharacter* Player);
+
+	// Prompts and highlights go here, overlapping interactives only get one focused at a time per player
+	virtual void OnPlayerFocusBegin(class ARPGPluginCharacter* Player);
+
+	virtual void OnPlayerFocusEnd(class ARPGPluginCharacter* Player);
 
 };
@@ -3,15 +3,27 @@
 
 #include "Checkpoint.h"
 #include "RPGPluginCharacter.h"
+#include "QuestObjectiveSubsystem.h"
 
 
+void ACheckpoint::OnPlayerBeginOverlap(ARPGPluginCharacter* Player)
+{
+	// Reaching the checkpoint counts for the quest objectives waiting on it
+	UQuestObjectiveSubsystem* QuestObjectives = GetWorld()->GetSubsystem<UQuestObjectiveSubsystem>();
+
+	if (QuestObjectives != nullptr)
+	{
+		QuestObjectives->NotifyCheckpointReached(Player, InteractiveName);
+	}
+}
+
 void ACheckpoint::OnInteract_Implementation()
 {
 	UE_LOG(LogTemp, Warning, TEXT("OnInteract Checkpoint"));
 
-	if (PlayerCharacter != nullptr)
+	if (ARPGPluginCharacter* Player = PlayerCharacter.Get())
 	{
-		PlayerCharacter->TriggerCheckPoint();
+		Player->TriggerCheckPoint();
 	}
 }
 
@@ -15,6 +15,10 @@ class RPGPLUGIN_API ACheckpoint : public ABasicInteractive, public IInteractable
 {
 	GENERATED_BODY()
 
+protected:
+
+	void OnPlayerBeginOverlap(ARPGPluginCharacter* Player) override;
+
 
 		//////////// INTERFACE IInteractable //////////////////
 public:
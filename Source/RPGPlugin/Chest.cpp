@@ -11,25 +11,31 @@ AChest::AChest()
 	PrimaryActorTick.bCanEverTick = true;
 }
 
+void AChest::BeginPlay()
+{
+	bQuestActivatedOnLevel = QuestActivated;
+
+	Super::BeginPlay();
+}
+
+void AChest::ApplyPersistentFlag(bool bFlag)
+{
+	QuestActivated = bQuestActivatedOnLevel && !bFlag;
+}
 
 
 
-void AChest::OnPlayerBeginOverlap()
+
+void AChest::OnPlayerFocusBegin(ARPGPluginCharacter* Player)
 {
-	if (PlayerCharacter != nullptr)
-	{
-		PlayerCharacter->OnShowUI(InteractiveName);
-	}
+	Player->OnShowUI(InteractiveName);
 
 }
 
 
-void AChest::OnPlayerEndOverlap()
+void AChest::OnPlayerFocusEnd(ARPGPluginCharacter* Player)
 {
-	if (PlayerCharacter != nullptr)
-	{
-		PlayerCharacter->OnHideUI();
-	}
+	Player->OnHideUI();
 
 }
 
@@ -38,49 +44,58 @@ void AChest::OnInteract_Implementation()
 {
 	// Retrieve info quest from game mode
 	ARPGPluginGameMode* GameMode = Cast<ARPGPluginGameMode>(GetWorld()->GetAuthGameMode());
-	if (GameMode == nullptr) return;
+	ARPGPluginCharacter* Player = PlayerCharacter.Get();
+	if ((GameMode == nullptr) || (Player == nullptr)) return;
 
 	if (!QuestActivated) return;
 
-	bool Success = false;
 	// Find the quest on the game mode
-	FQuest Quest = GameMode->FindQuest(QuestID, Success);
+	const FQuest* QuestData = GameMode->FindQuestData(QuestID);
+
+	if (QuestData == nullptr) return;
 
-	if (!Success) return;
+	const FQuest& Quest = *QuestData;
 
 	// Check if player has already accepted the quest
 	bool bQuestAccepted = false;
 	FQuestItem QuestInfo;
-	bQuestAccepted = PlayerCharacter->FindQuest(QuestID, QuestInfo);
+	bQuestAccepted = Player->FindQuest(QuestID, QuestInfo);
 
 	// Quest not accepted, show info quest mark quest as a accepted
 	if (!bQuestAccepted)
 	{
-		PlayerCharacter->OnShowQuestInfo(Quest);
-		PlayerCharacter->AcceptQuest(QuestID);
+		if (!Player->CanAcceptQuest(QuestID))
+		{
+			Player->OnShowQuestLocked(Quest);
+			return;
+		}
+
+		Player->ShowQuestInfo(QuestID);
+		Player->AcceptQuest(QuestID);
 	}
 	else
 	{
 		// If quest is not completed yet, check if player has the item
 		if (!QuestInfo.IsCompleted)
 		{
-			if (PlayerCharacter->HasItemOnHands(Quest.ItemID))
+			if (Player->HasItemOnHands(Quest.ItemID) && Player->AreQuestObjectivesDone(QuestID))
 			{
-				PlayerCharacter->RemoveItem(Quest.ItemID, true);
-				PlayerCharacter->MarkQuestCompleted(QuestID);
+				Player->RemoveItem(Quest.ItemID, true);
+				Player->MarkQuestCompleted(QuestID);
 
-				PlayerCharacter->OnShowQuestCompleted(Quest.CompleteMessage);
+				Player->OnShowQuestCompleted(Quest.CompleteMessage);
 				QuestActivated = false;
+				SetPersistentFlag(true);
 
 			}
 			else
 			{
-				PlayerCharacter->OnShowQuestInfo(Quest);
+				Player->ShowQuestInfo(QuestID);
 			}
 		}
 		else
 		{
-			PlayerCharacter->OnShowQuestInfo(Quest);
+			Player->ShowQuestInfo(QuestID);
 		}
 	}
 }
@@ -19,12 +19,19 @@ public:
 
 	AChest();
 
-
 protected:
 
-	void OnPlayerBeginOverlap() override;
+	void BeginPlay() override;
+
+	// Completed chests stay completed after a reload
+	void ApplyPersistentFlag(bool bFlag) override;
+
+	// QuestActivated as placed on the level, restored when a save without this chest completed is loaded
+	bool bQuestActivatedOnLevel = false;
+
+	void OnPlayerFocusBegin(ARPGPluginCharacter* Player) override;
 
-	void OnPlayerEndOverlap() override;
+	void OnPlayerFocusEnd(ARPGPluginCharacter* Player) override;
 
 	//////////// INTERFACE IInteractable //////////////////
 public:
@@ -0,0 +1,721 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CompactSaveFormat.h"
+#include "RPGPluginGameInstance.h"
+#include "Kismet/GameplayStatics.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/FileManager.h"
+#include "Misc/Compression.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+FArchive& operator<<(FArchive& Ar, FCompactSaveFormat::FHeader& Header)
+{
+	Ar << Header.FileMagic;
+	Ar << Header.FileVersion;
+	Ar << Header.Compression;
+	Ar << Header.Reserved;
+	Ar << Header.RawSize;
+	Ar << Header.PayloadSize;
+	Ar << Header.PayloadCrc;
+	return Ar;
+}
+
+void FCompactSaveFormat::Pack(const UMainSaveGame& SaveGame, TArray<uint8>& OutBody)
+{
+	FCompactSavePacker Packer(SaveGame, OutBody);
+	Packer.Step(TNumericLimits<double>::Max());
+}
+
+bool FCompactSaveFormat::Unpack(const TArray<uint8>& Body, UMainSaveGame& OutSaveGame)
+{
+	FMemoryReader Reader(Body);
+
+	int64 CreationTicks = 0;
+	Reader << OutSaveGame.SaveGameName << CreationTicks << OutSaveGame.JournalGeneration;
+	OutSaveGame.CreationTime = FDateTime(CreationTicks);
+
+	int32 NumQuests = 0;
+	Reader << NumQuests;
+
+	// Every quest takes at least a few bytes, anything bigger is a corrupted count
+	if (Reader.IsError() || (NumQuests < 0) || (NumQuests > Body.Num()))
+	{
+		return false;
+	}
+
+	TArray<FQuestItem>& Quests = OutSaveGame.QuestStatus;
+	Quests.SetNum(NumQuests);
+
+	for (FQuestItem& Quest : Quests)
+	{
+		Reader << Quest.QuestID;
+	}
+
+	TBitArray<> Completed;
+	TBitArray<> HasProgress;
+	TBitArray<> HasObjectives;
+	Reader << Completed << HasProgress << HasObjectives;
+
+	if (Reader.IsError() || (Completed.Num() != NumQuests) || (HasProgress.Num() != NumQuests) || (HasObjectives.Num() != NumQuests))
+	{
+		return false;
+	}
+
+	for (int i = 0; i < NumQuests; i++)
+	{
+		Quests[i].IsCompleted = Completed[i];
+		Quests[i].Progress = 0;
+		Quests[i].ObjectiveProgress.Reset();
+	}
+
+	for (TConstSetBitIterator<> It(HasProgress); It; ++It)
+	{
+		Reader << Quests[It.GetIndex()].Progress;
+	}
+
+	for (TConstSetBitIterator<> It(HasObjectives); It; ++It)
+	{
+		Reader << Quests[It.GetIndex()].ObjectiveProgress;
+	}
+
+	int32 NumItems = 0;
+	Reader << NumItems;
+
+	if (Reader.IsError() || (NumItems < 0) || (NumItems > Body.Num()))
+	{
+		return false;
+	}
+
+	TArray<FInventorySaveItem>& Items = OutSaveGame.Inventory;
+	Items.SetNum(NumItems);
+
+	for (FInventorySaveItem& Item : Items)
+	{
+		Reader << Item.ItemID;
+	}
+
+	for (FInventorySaveItem& Item : Items)
+	{
+		Reader << Item.Quantity;
+		Item.InstanceData = 0;
+	}
+
+	TBitArray<> HasInstanceData;
+	Reader << HasInstanceData;
+
+	if (Reader.IsError() || (HasInstanceData.Num() != NumItems))
+	{
+		return false;
+	}
+
+	for (TConstSetBitIterator<> It(HasInstanceData); It; ++It)
+	{
+		Reader << Items[It.GetIndex()].InstanceData;
+	}
+
+	OutSaveGame.WorldStateIDs.Reset();
+	OutSaveGame.WorldStateBits.Reset();
+
+	// Bodies before version 3 end here
+	if (Reader.AtEnd())
+	{
+		return !Reader.IsError();
+	}
+
+	int32 NumWorldState = 0;
+	Reader << NumWorldState;
+
+	if (Reader.IsError() || (NumWorldState < 0) || (NumWorldState > Body.Num()))
+	{
+		return false;
+	}
+
+	OutSaveGame.WorldStateIDs.SetNum(NumWorldState);
+
+	for (FName& ID : OutSaveGame.WorldStateIDs)
+	{
+		Reader << ID;
+	}
+
+	TBitArray<> WorldStateFlags;
+	Reader << WorldStateFlags;
+
+	if (Reader.IsError() || (WorldStateFlags.Num() != NumWorldState))
+	{
+		return false;
+	}
+
+	OutSaveGame.WorldStateBits.SetNumZeroed((NumWorldState + 31) / 32);
+
+	for (TConstSetBitIterator<> It(WorldStateFlags); It; ++It)
+	{
+		OutSaveGame.WorldStateBits[It.GetIndex() / 32] |= (1u << (It.GetIndex() % 32));
+	}
+
+	return !Reader.IsError();
+}
+
+bool FCompactSaveFormat::Encode(const TArray<uint8>& Body, const FSaveSlotMetadata& Metadata, TArray<uint8>& OutFile)
+{
+	const int32 PayloadOffset = GetPayloadOffset(Version);
+
+	FHeader Header;
+	Header.FileMagic = Magic;
+	Header.FileVersion = Version;
+	Header.RawSize = Body.Num();
+
+	// Oodle when the platform has it, zlib otherwise
+	Header.Compression = FCompression::IsFormatValid(GetCompressionFormat(ECompression::Oodle)) ? ECompression::Oodle : ECompression::Zlib;
+	const FName Format = GetCompressionFormat(Header.Compression);
+
+	int32 CompressedSize = FCompression::CompressMemoryBound(Format, Body.Num());
+
+	OutFile.SetNumUninitialized(PayloadOffset + CompressedSize);
+
+	if (!FCompression::CompressMemory(Format, OutFile.GetData() + PayloadOffset, CompressedSize, Body.GetData(), Body.Num()) || (CompressedSize >= Body.Num()))
+	{
+		// Not worth it, store the body as is
+		Header.Compression = ECompression::None;
+		CompressedSize = Body.Num();
+
+		OutFile.SetNumUninitialized(PayloadOffset + CompressedSize);
+		FMemory::Memcpy(OutFile.GetData() + PayloadOffset, Body.GetData(), Body.Num());
+	}
+
+	OutFile.SetNum(PayloadOffset + CompressedSize, false);
+
+	Header.PayloadSize = CompressedSize;
+	Header.PayloadCrc = FCrc::MemCrc32(OutFile.GetData() + PayloadOffset, CompressedSize);
+
+	WriteMetadata(Metadata, OutFile.GetData() + FHeader::Size);
+
+	TArray<uint8> HeaderData;
+	FMemoryWriter HeaderWriter(HeaderData);
+	HeaderWriter << Header;
+
+	check(HeaderData.Num() == FHeader::Size);
+	FMemory::Memcpy(OutFile.GetData(), HeaderData.GetData(), FHeader::Size);
+
+	return true;
+}
+
+bool FCompactSaveFormat::Decode(const TArray<uint8>& File, TArray<uint8>& OutBody, FSaveSlotMetadata* OutMetadata)
+{
+	if (!IsCompactSave(File))
+	{
+		return false;
+	}
+
+	FHeader Header;
+	FMemoryReader HeaderReader(File);
+	HeaderReader << Header;
+
+	if (Header.FileVersion > Version)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("[FCompactSaveFormat::Decode] Save version %d is newer than %d"), Header.FileVersion, Version);
+		return false;
+	}
+
+	const int32 PayloadOffset = GetPayloadOffset(Header.FileVersion);
+
+	if ((int64)PayloadOffset + Header.PayloadSize != File.Num())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("[FCompactSaveFormat::Decode] Truncated save, %d bytes expected"), PayloadOffset + Header.PayloadSize);
+		return false;
+	}
+
+	if ((OutMetadata != nullptr) && (Header.FileVersion >= 2))
+	{
+		ReadMetadataBlock(File.GetData() + FHeader::Size, *OutMetadata);
+	}
+
+	const uint8* Payload = File.GetData() + PayloadOffset;
+
+	if (FCrc::MemCrc32(Payload, Header.PayloadSize) != Header.PayloadCrc)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("[FCompactSaveFormat::Decode] Checksum mismatch"));
+		return false;
+	}
+
+	// A corrupted size must not reach the allocation below
+	const bool bStored = (Header.Compression == ECompression::None);
+
+	if ((bStored && (Header.RawSize != Header.PayloadSize)) || (Header.RawSize > MaxRawSize))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("[FCompactSaveFormat::Decode] Invalid body size %u"), Header.RawSize);
+		return false;
+	}
+
+	OutBody.SetNumUninitialized(Header.RawSize);
+
+	if (bStored)
+	{
+		FMemory::Memcpy(OutBody.GetData(), Payload, Header.PayloadSize);
+		return true;
+	}
+
+	return FCompression::UncompressMemory(GetCompressionFormat(Header.Compression), OutBody.GetData(), Header.RawSize, Payload, Header.PayloadSize);
+}
+
+bool FCompactSaveFormat::IsCompactSave(const TArray<uint8>& File)
+{
+	return (File.Num() >= FHeader::Size) && (FMemory::Memcmp(File.GetData(), &Magic, sizeof(Magic)) == 0);
+}
+
+bool FCompactSaveFormat::ReadMetadata(const FString& FilePath, FSaveSlotMetadata& OutMetadata)
+{
+	TUniquePtr<FArchive> File(IFileManager::Get().CreateFileReader(*FilePath, FILEREAD_Silent));
+
+	if (!File.IsValid() || (File->TotalSize() < FHeader::Size))
+	{
+		return false;
+	}
+
+	// Partial read, the body is never loaded
+	TArray<uint8> Prefix;
+	Prefix.SetNumUninitialized(FMath::Min<int64>(File->TotalSize(), GetPrefixSize()));
+	File->Serialize(Prefix.GetData(), Prefix.Num());
+	File->Close();
+
+	if (!IsCompactSave(Prefix))
+	{
+		return false;
+	}
+
+	FHeader Header;
+	FMemoryReader HeaderReader(Prefix);
+	HeaderReader << Header;
+
+	// Version 1 files have no metadata, only the slot shows up
+	if ((Header.FileVersion < 2) || (Prefix.Num() < FHeader::Size + MetadataSize))
+	{
+		return true;
+	}
+
+	return ReadMetadataBlock(Prefix.GetData() + FHeader::Size, OutMetadata);
+}
+
+int32 FCompactSaveFormat::GetPrefixSize()
+{
+	return FHeader::Size + MetadataSize;
+}
+
+static void WriteMetadataString(FArchive& Writer, const FString& Value)
+{
+	FTCHARToUTF8 Converted(*Value);
+
+	int32 Length = FMath::Min(Converted.Length(), FCompactSaveFormat::MaxMetadataString);
+
+	// Don't cut a multi-byte character in half
+	while ((Length > 0) && (Length < Converted.Length()) && ((Converted.Get()[Length] & 0xC0) == 0x80))
+	{
+		Length--;
+	}
+
+	uint8 StoredLength = Length;
+	Writer << StoredLength;
+
+	uint8 Text[FCompactSaveFormat::MaxMetadataString] = {};
+	FMemory::Memcpy(Text, Converted.Get(), Length);
+	Writer.Serialize(Text, FCompactSaveFormat::MaxMetadataString);
+}
+
+static FString ReadMetadataString(FArchive& Reader)
+{
+	uint8 StoredLength = 0;
+	Reader << StoredLength;
+
+	ANSICHAR Text[FCompactSaveFormat::MaxMetadataString] = {};
+	Reader.Serialize(Text, FCompactSaveFormat::MaxMetadataString);
+
+	const int32 Length = FMath::Min<int32>(StoredLength, FCompactSaveFormat::MaxMetadataString);
+	FUTF8ToTCHAR Converted(Text, Length);
+	return FString(Converted.Length(), Converted.Get());
+}
+
+void FCompactSaveFormat::WriteMetadata(const FSaveSlotMetadata& Metadata, uint8* Dest)
+{
+	TArray<uint8> Block;
+	FMemoryWriter Writer(Block);
+
+	int64 SaveTicks = Metadata.SaveTime.GetTicks();
+	int64 CreationTicks = Metadata.CreationTime.GetTicks();
+	double PlaytimeSeconds = Metadata.PlaytimeSeconds;
+	Writer << SaveTicks << CreationTicks << PlaytimeSeconds;
+
+	WriteMetadataString(Writer, Metadata.DisplayName);
+	WriteMetadataString(Writer, Metadata.LevelName);
+
+	// The checksum goes first and covers the rest of the block
+	check(Block.Num() + (int32)sizeof(uint32) <= MetadataSize);
+	Block.SetNumZeroed(MetadataSize - sizeof(uint32));
+
+	const uint32 Crc = FCrc::MemCrc32(Block.GetData(), Block.Num());
+	FMemory::Memcpy(Dest, &Crc, sizeof(Crc));
+	FMemory::Memcpy(Dest + sizeof(Crc), Block.GetData(), Block.Num());
+}
+
+bool FCompactSaveFormat::ReadMetadataBlock(const uint8* Source, FSaveSlotMetadata& OutMetadata)
+{
+	uint32 Crc = 0;
+	FMemory::Memcpy(&Crc, Source, sizeof(Crc));
+
+	if (FCrc::MemCrc32(Source + sizeof(Crc), MetadataSize - sizeof(Crc)) != Crc)
+	{
+		return false;
+	}
+
+	TArray<uint8> Block(Source + sizeof(Crc), MetadataSize - sizeof(Crc));
+	FMemoryReader Reader(Block);
+
+	int64 SaveTicks = 0;
+	int64 CreationTicks = 0;
+	double PlaytimeSeconds = 0.0;
+	Reader << SaveTicks << CreationTicks << PlaytimeSeconds;
+
+	OutMetadata.PlaytimeSeconds = PlaytimeSeconds;
+
+	OutMetadata.SaveTime = FDateTime(SaveTicks);
+	OutMetadata.CreationTime = FDateTime(CreationTicks);
+	OutMetadata.DisplayName = ReadMetadataString(Reader);
+	OutMetadata.LevelName = ReadMetadataString(Reader);
+
+	return !Reader.IsError();
+}
+
+FName FCompactSaveFormat::GetCompressionFormat(ECompression Compression)
+{
+	static const FName OodleFormat(TEXT("Oodle"));
+
+	switch (Compression)
+	{
+	case ECompression::Oodle: return OodleFormat;
+	case ECompression::Zlib: return NAME_Zlib;
+	default: return NAME_None;
+	}
+}
+
+//// FCompactSavePacker ///////
+
+FCompactSavePacker::FCompactSavePacker(const UMainSaveGame& SaveGame, TArray<uint8>& OutBody)
+	: Writer(OutBody)
+{
+	OutBody.Reset();
+
+	FString SaveGameName = SaveGame.SaveGameName;
+	int64 CreationTicks = SaveGame.CreationTime.GetTicks();
+	int32 JournalGeneration = SaveGame.JournalGeneration;
+	Writer << SaveGameName << CreationTicks << JournalGeneration;
+
+	Quests = &SaveGame.QuestStatus;
+	Items = &SaveGame.Inventory;
+	WorldStateIDs = &SaveGame.WorldStateIDs;
+	WorldStateBits = &SaveGame.WorldStateBits;
+
+	BeginPhase(EPhase::QuestIDs);
+}
+
+bool FCompactSavePacker::Step(double Deadline)
+{
+	// Reading the clock for every element would cost more than packing it
+	static const int32 ElementsPerClockCheck = 64;
+
+	int32 Count = 0;
+
+	while (Phase != EPhase::Done)
+	{
+		if ((++Count % ElementsPerClockCheck == 0) && (FPlatformTime::Seconds() >= Deadline))
+		{
+			return false;
+		}
+
+		PackNext();
+	}
+
+	return true;
+}
+
+void FCompactSavePacker::Detach()
+{
+	// Sections already packed are not read again
+	if ((Phase <= EPhase::QuestObjectives) && (Quests != &QuestsCopy))
+	{
+		QuestsCopy = *Quests;
+		Quests = &QuestsCopy;
+	}
+
+	if ((Phase <= EPhase::ItemInstanceData) && (Items != &ItemsCopy))
+	{
+		ItemsCopy = *Items;
+		Items = &ItemsCopy;
+	}
+
+	if ((Phase <= EPhase::WorldStateIDs) && (WorldStateIDs != &WorldStateIDsCopy))
+	{
+		WorldStateIDsCopy = *WorldStateIDs;
+		WorldStateIDs = &WorldStateIDsCopy;
+
+		WorldStateBitsCopy = *WorldStateBits;
+		WorldStateBits = &WorldStateBitsCopy;
+	}
+}
+
+void FCompactSavePacker::BeginPhase(EPhase NextPhase)
+{
+	Phase = NextPhase;
+	Cursor = 0;
+
+	// Section headers, same layout as FCompactSaveFormat::Unpack reads
+	switch (Phase)
+	{
+	case EPhase::QuestIDs:
+	{
+		int32 NumQuests = Quests->Num();
+		Writer << NumQuests;
+
+		Completed.Init(false, NumQuests);
+		HasProgress.Init(false, NumQuests);
+		HasObjectives.Init(false, NumQuests);
+		break;
+	}
+	case EPhase::ItemIDs:
+	{
+		int32 NumItems = Items->Num();
+		Writer << NumItems;
+
+		HasInstanceData.Init(false, NumItems);
+		break;
+	}
+	case EPhase::WorldStateIDs:
+	{
+		int32 NumWorldState = WorldStateIDs->Num();
+		Writer << NumWorldState;
+
+		WorldStateFlags.Init(false, NumWorldState);
+		break;
+	}
+	case EPhase::Done:
+		// Nothing is read from the save anymore
+		QuestsCopy.Empty();
+		ItemsCopy.Empty();
+		WorldStateIDsCopy.Empty();
+		WorldStateBitsCopy.Empty();
+		break;
+	default:
+		break;
+	}
+}
+
+void FCompactSavePacker::PackNext()
+{
+	switch (Phase)
+	{
+	//// Quests: ID table, completed bitset, progress only for the quests that have some ///////
+	case EPhase::QuestIDs:
+		if (Cursor < Quests->Num())
+		{
+			const FQuestItem& Quest = (*Quests)[Cursor];
+
+			FName QuestID = Quest.QuestID;
+			Writer << QuestID;
+
+			Completed[Cursor] = Quest.IsCompleted;
+			HasProgress[Cursor] = (Quest.Progress != 0);
+			HasObjectives[Cursor] = (Quest.ObjectiveProgress.Num() > 0);
+			Cursor++;
+		}
+		else
+		{
+			Writer << Completed << HasProgress << HasObjectives;
+			BeginPhase(EPhase::QuestProgress);
+		}
+		break;
+
+	case EPhase::QuestProgress:
+		if (Cursor < Quests->Num())
+		{
+			if (HasProgress[Cursor])
+			{
+				int32 Progress = (*Quests)[Cursor].Progress;
+				Writer << Progress;
+			}
+			Cursor++;
+		}
+		else
+		{
+			BeginPhase(EPhase::QuestObjectives);
+		}
+		break;
+
+	case EPhase::QuestObjectives:
+		if (Cursor < Quests->Num())
+		{
+			if (HasObjectives[Cursor])
+			{
+				TArray<int32> ObjectiveProgress = (*Quests)[Cursor].ObjectiveProgress;
+				Writer << ObjectiveProgress;
+			}
+			Cursor++;
+		}
+		else
+		{
+			BeginPhase(EPhase::ItemIDs);
+		}
+		break;
+
+	//// Inventory: ID table, then one quantity per ID ///////
+	case EPhase::ItemIDs:
+		if (Cursor < Items->Num())
+		{
+			FName ItemID = (*Items)[Cursor].ItemID;
+			Writer << ItemID;
+
+			HasInstanceData[Cursor] = ((*Items)[Cursor].InstanceData != 0);
+			Cursor++;
+		}
+		else
+		{
+			BeginPhase(EPhase::ItemQuantities);
+		}
+		break;
+
+	case EPhase::ItemQuantities:
+		if (Cursor < Items->Num())
+		{
+			int32 Quantity = (*Items)[Cursor].Quantity;
+			Writer << Quantity;
+			Cursor++;
+		}
+		else
+		{
+			Writer << HasInstanceData;
+			BeginPhase(EPhase::ItemInstanceData);
+		}
+		break;
+
+	case EPhase::ItemInstanceData:
+		if (Cursor < Items->Num())
+		{
+			if (HasInstanceData[Cursor])
+			{
+				int32 InstanceData = (*Items)[Cursor].InstanceData;
+				Writer << InstanceData;
+			}
+			Cursor++;
+		}
+		else
+		{
+			BeginPhase(EPhase::WorldStateIDs);
+		}
+		break;
+
+	//// World state: ID table and one bit per ID ///////
+	case EPhase::WorldStateIDs:
+		if (Cursor < WorldStateIDs->Num())
+		{
+			FName ID = (*WorldStateIDs)[Cursor];
+			Writer << ID;
+
+			const int32 Word = Cursor / 32;
+			WorldStateFlags[Cursor] = WorldStateBits->IsValidIndex(Word) && (((*WorldStateBits)[Word] & (1u << (Cursor % 32))) != 0);
+			Cursor++;
+		}
+		else
+		{
+			Writer << WorldStateFlags;
+			BeginPhase(EPhase::Done);
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+
+//// Benchmark ///////
+
+// rpg.Save.Benchmark [NumQuests] [NumItems]: compares the compact format with SaveGameToMemory on a synthetic save
+static FAutoConsoleCommand SaveBenchmarkCommand(
+	TEXT("rpg.Save.Benchmark"),
+	TEXT("Compares save/load time and size of the compact save format against SaveGameToMemory. Args: [NumQuests=1000] [NumItems=200]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic([](const TArray<FString>& Args)
+	{
+		const int32 NumQuests = (Args.Num() > 0) ? FCString::Atoi(*Args[0]) : 1000;
+		const int32 NumItems = (Args.Num() > 1) ? FCString::Atoi(*Args[1]) : 200;
+		const int32 NumRuns = 10;
+
+		UMainSaveGame* SaveGame = NewObject<UMainSaveGame>(GetTransientPackage());
+		SaveGame->CreateSlot(TEXT("Benchmark"));
+
+		for (int i = 0; i < NumQuests; i++)
+		{
+			FQuestItem& Quest = SaveGame->QuestStatus.AddDefaulted_GetRef();
+			Quest.QuestID = FName(*FString::Printf(TEXT("Quest_%d"), i));
+			Quest.IsCompleted = (i % 3 == 0);
+			Quest.Progress = (i % 4 == 0) ? i : 0;
+
+			if (i % 5 == 0)
+			{
+				Quest.ObjectiveProgress = { 1, 0, 3 };
+			}
+		}
+
+		for (int i = 0; i < NumItems; i++)
+		{
+			FInventorySaveItem& Item = SaveGame->Inventory.AddDefaulted_GetRef();
+			Item.ItemID = FName(*FString::Printf(TEXT("Item_%d"), i));
+			Item.Quantity = 1 + i % 7;
+		}
+
+		// Legacy tagged property format
+		TArray<uint8> LegacyData;
+		double LegacySave = FPlatformTime::Seconds();
+		for (int Run = 0; Run < NumRuns; Run++)
+		{
+			UGameplayStatics::SaveGameToMemory(SaveGame, LegacyData);
+		}
+		LegacySave = (FPlatformTime::Seconds() - LegacySave) / NumRuns;
+
+		double LegacyLoad = FPlatformTime::Seconds();
+		for (int Run = 0; Run < NumRuns; Run++)
+		{
+			UGameplayStatics::LoadGameFromMemory(LegacyData);
+		}
+		LegacyLoad = (FPlatformTime::Seconds() - LegacyLoad) / NumRuns;
+
+		// Compact format, packing on the game thread and encoding on the worker are timed apart
+		TArray<uint8> Body;
+		TArray<uint8> CompactData;
+		double CompactPack = 0.0;
+		double CompactEncode = 0.0;
+		for (int Run = 0; Run < NumRuns; Run++)
+		{
+			double Start = FPlatformTime::Seconds();
+			FCompactSaveFormat::Pack(*SaveGame, Body);
+			CompactPack += FPlatformTime::Seconds() - Start;
+
+			Start = FPlatformTime::Seconds();
+			FCompactSaveFormat::Encode(Body, FSaveSlotMetadata(), CompactData);
+			CompactEncode += FPlatformTime::Seconds() - Start;
+		}
+		CompactPack /= NumRuns;
+		CompactEncode /= NumRuns;
+
+		UMainSaveGame* Loaded = NewObject<UMainSaveGame>(GetTransientPackage());
+		double CompactLoad = FPlatformTime::Seconds();
+		for (int Run = 0; Run < NumRuns; Run++)
+		{
+			TArray<uint8> DecodedBody;
+			FCompactSaveFormat::Decode(CompactData, DecodedBody);
+			FCompactSaveFormat::Unpack(DecodedBody, *Loaded);
+		}
+		CompactLoad = (FPlatformTime::Seconds() - CompactLoad) / NumRuns;
+
+		UE_LOG(LogTemp, Display, TEXT("[rpg.Save.Benchmark] %d quests, %d items"), NumQuests, NumItems);
+		UE_LOG(LogTemp, Display, TEXT("  Legacy:  %7d bytes, save %.3f ms, load %.3f ms"), LegacyData.Num(), LegacySave * 1000.0, LegacyLoad * 1000.0);
+		UE_LOG(LogTemp, Display, TEXT("  Compact: %7d bytes (%d raw), pack %.3f ms + encode %.3f ms (worker), load %.3f ms"),
+			CompactData.Num(), Body.Num(), CompactPack * 1000.0, CompactEncode * 1000.0, CompactLoad * 1000.0);
+	}));
@@ -0,0 +1,165 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Serialization/MemoryWriter.h"
+#include "ItemData.h"
+
+class UMainSaveGame;
+struct FSaveSlotMetadata;
+
+/**
+ * Binary save format for UMainSaveGame, replacing the tagged property serialization of SaveGameToSlot.
+ * File layout: a fixed header (magic, version, compression, sizes, checksum), a fixed-size metadata block
+ * for the load menu, then the compressed body. Header and metadata can be read without touching the body.
+ * The body holds name tables and tightly packed arrays, values that are mostly zero go behind a bitset.
+ *
+ * Pack/Unpack touch the UObject and run on the game thread. Encode/Decode only work on bytes,
+ * so the compression and the checksum run on a worker thread.
+ */
+class RPGPLUGIN_API FCompactSaveFormat
+{
+public:
+
+	static const uint32 Magic = 0x53475052; // "RPGS"
+
+	// 1: first compact version. Files without the magic are legacy SaveGameToSlot files
+	// 2: slot metadata block after the header
+	// 3: world state table at the end of the body
+	static const uint16 Version = 3;
+
+	// Metadata strings longer than this many UTF-8 bytes are cut
+	static const int32 MaxMetadataString = 63;
+
+	// Bodies bigger than this are rejected on decode, the header is not covered by the checksum
+	static const uint32 MaxRawSize = 256 * 1024 * 1024;
+
+	enum class ECompression : uint8
+	{
+		None = 0,
+		Zlib = 1,
+		Oodle = 2,
+	};
+
+	// Save state into the uncompressed body
+	static void Pack(const UMainSaveGame& SaveGame, TArray<uint8>& OutBody);
+
+	// Body into the save state, false if the body is malformed
+	static bool Unpack(const TArray<uint8>& Body, UMainSaveGame& OutSaveGame);
+
+	// Header, metadata and compressed body
+	static bool Encode(const TArray<uint8>& Body, const FSaveSlotMetadata& Metadata, TArray<uint8>& OutFile);
+
+	// Checks the header and the checksum, then decompresses the body. OutMetadata is optional
+	static bool Decode(const TArray<uint8>& File, TArray<uint8>& OutBody, FSaveSlotMetadata* OutMetadata = nullptr);
+
+	static bool IsCompactSave(const TArray<uint8>& File);
+
+	// Reads only the first bytes of the file. False if the file is not a compact save
+	static bool ReadMetadata(const FString& FilePath, FSaveSlotMetadata& OutMetadata);
+
+	// Bytes to read from the start of a file to get header and metadata
+	static int32 GetPrefixSize();
+
+	struct FHeader
+	{
+		uint32 FileMagic = 0;
+
+		uint16 FileVersion = 0;
+
+		ECompression Compression = ECompression::None;
+
+		uint8 Reserved = 0;
+
+		uint32 RawSize = 0;
+
+		uint32 PayloadSize = 0;
+
+		uint32 PayloadCrc = 0;
+
+		static const int32 Size = 20;
+
+		friend FArchive& operator<<(FArchive& Ar, FHeader& Header);
+	};
+
+	// Crc, save time, creation time, playtime, display name, level name, padding
+	static const int32 MetadataSize = 160;
+
+private:
+
+	static void WriteMetadata(const FSaveSlotMetadata& Metadata, uint8* Dest);
+
+	static bool ReadMetadataBlock(const uint8* Source, FSaveSlotMetadata& OutMetadata);
+
+	static int32 GetPayloadOffset(uint16 FileVersion) { return FHeader::Size + ((FileVersion >= 2) ? MetadataSize : 0); }
+
+	static FName GetCompressionFormat(ECompression Compression);
+};
+
+/**
+ * FCompactSaveFormat::Pack in small steps, so a large save can be packed over several frames.
+ * The arrays of the save are read in place. Detach must be called before the save is modified or destroyed:
+ * it copies the sections not packed yet, so the body is still the state the save had when packing started.
+ */
+class RPGPLUGIN_API FCompactSavePacker
+{
+public:
+
+	// Writes the fields outside of the sections right away
+	FCompactSavePacker(const UMainSaveGame& SaveGame, TArray<uint8>& OutBody);
+
+	FCompactSavePacker(const FCompactSavePacker&) = delete;
+	FCompactSavePacker& operator=(const FCompactSavePacker&) = delete;
+
+	// Packs until the body is complete or until Deadline (FPlatformTime::Seconds). True once complete
+	bool Step(double Deadline);
+
+	bool IsDone() const { return Phase == EPhase::Done; }
+
+	// Copy on write, the save is about to change
+	void Detach();
+
+private:
+
+	enum class EPhase : uint8
+	{
+		QuestIDs,
+		QuestProgress,
+		QuestObjectives,
+		ItemIDs,
+		ItemQuantities,
+		ItemInstanceData,
+		WorldStateIDs,
+		Done,
+	};
+
+	// One element, or the transition to the next phase
+	void PackNext();
+
+	void BeginPhase(EPhase NextPhase);
+
+	FMemoryWriter Writer;
+
+	EPhase Phase = EPhase::QuestIDs;
+
+	// Element of the current phase
+	int32 Cursor = 0;
+
+	// Point to the save, or to the copies once detached
+	const TArray<FQuestItem>* Quests = nullptr;
+	const TArray<FInventorySaveItem>* Items = nullptr;
+	const TArray<FName>* WorldStateIDs = nullptr;
+	const TArray<uint32>* WorldStateBits = nullptr;
+
+	TArray<FQuestItem> QuestsCopy;
+	TArray<FInventorySaveItem> ItemsCopy;
+	TArray<FName> WorldStateIDsCopy;
+	TArray<uint32> WorldStateBitsCopy;
+
+	TBitArray<> Completed;
+	TBitArray<> HasProgress;
+	TBitArray<> HasObjectives;
+	TBitArray<> HasInstanceData;
+	TBitArray<> WorldStateFlags;
+};
@@ -0,0 +1,133 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "DamageQueueSubsystem.h"
+#include "RPGPlugin.h"
+#include "RPGPluginCharacter.h"
+#include "DefaultEnemy.h"
+#include "QuestObjectiveSubsystem.h"
+#include "Engine/World.h"
+
+DECLARE_CYCLE_STAT(TEXT("Damage Resolve"), STAT_DamageResolve, STATGROUP_RPGPlugin);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Damage Hits Resolved"), STAT_DamageHits, STATGROUP_RPGPlugin);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Damage Targets Resolved"), STAT_DamageTargets, STATGROUP_RPGPlugin);
+
+
+void UDamageQueueSubsystem::Deinitialize()
+{
+	Queue.Empty();
+	Hits.Empty();
+	Results.Empty();
+
+	Super::Deinitialize();
+}
+
+TStatId UDamageQueueSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UDamageQueueSubsystem, STATGROUP_Tickables);
+}
+
+void UDamageQueueSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	ResolveDamage();
+}
+
+void UDamageQueueSubsystem::QueueDamage(AActor* Source, AActor* Target, float Amount, EDamageKind Kind)
+{
+	if ((Target == nullptr) || (Amount <= 0.0f)) return;
+
+	Queue.Add({ Source, Target, Amount, Kind });
+}
+
+void UDamageQueueSubsystem::ResolveDamage()
+{
+	if (Queue.Num() == 0) return;
+
+	SCOPE_CYCLE_COUNTER(STAT_DamageResolve);
+
+	Hits.Reset(Queue.Num());
+	Results.Reset();
+
+	for (const FQueuedDamage& Queued : Queue)
+	{
+		// Targets destroyed since the hit are dropped
+		AActor* Target = Queued.Target.Get();
+		if (Target == nullptr) continue;
+
+		const bool bPiercing = (Queued.Kind == EDamageKind::E_Piercing);
+		Hits.Add({ Target, Queued.Source.Get(), bPiercing ? 0.0f : Queued.Amount, bPiercing ? Queued.Amount : 0.0f });
+	}
+
+	SET_DWORD_STAT(STAT_DamageHits, Hits.Num());
+
+	// Notifications below may queue more damage, it is resolved on the next frame
+	Queue.Reset();
+
+	// Stable, so the last hit on each target stays last
+	Hits.StableSort([](const FResolvingHit& A, const FResolvingHit& B) { return A.Target < B.Target; });
+
+	//// Resolve: one change per target ///////
+	for (int32 First = 0; First < Hits.Num();)
+	{
+		FDamageResult& Result = Results.AddDefaulted_GetRef();
+		Result.Target = Hits[First].Target;
+
+		float ArmoredDamage = 0.0f;
+		float PiercingDamage = 0.0f;
+		int32 Last = First;
+
+		for (; (Last < Hits.Num()) && (Hits[Last].Target == Result.Target); Last++)
+		{
+			ArmoredDamage += Hits[Last].ArmoredDamage;
+			PiercingDamage += Hits[Last].PiercingDamage;
+		}
+
+		Result.Source = Hits[Last - 1].Source;
+		Result.Damage = ArmoredDamage + PiercingDamage;
+		Result.NumHits = Last - First;
+
+		if (ARPGPluginCharacter* Character = Cast<ARPGPluginCharacter>(Result.Target))
+		{
+			Result.bKilled = Character->ResolveDamage(ArmoredDamage, PiercingDamage);
+		}
+		else if (ADefaultEnemy* Enemy = Cast<ADefaultEnemy>(Result.Target))
+		{
+			// Enemies have no armor
+			Result.bKilled = Enemy->ResolveDamage(Result.Damage, Result.Source);
+		}
+
+		First = Last;
+	}
+
+	SET_DWORD_STAT(STAT_DamageTargets, Results.Num());
+
+	//// Notify: hits and deaths in bulk ///////
+	UQuestObjectiveSubsystem* QuestObjectives = GetWorld()->GetSubsystem<UQuestObjectiveSubsystem>();
+	int32 NumKilled = 0;
+
+	for (const FDamageResult& Result : Results)
+	{
+		NumKilled += Result.bKilled ? 1 : 0;
+
+		if (ARPGPluginCharacter* Character = Cast<ARPGPluginCharacter>(Result.Target))
+		{
+			Character->OnDamageTaken(Result.Damage);
+
+			if (Result.bKilled)
+			{
+				Character->OnDied();
+			}
+		}
+		else if (Result.bKilled && (QuestObjectives != nullptr))
+		{
+			// A character landing the killing blow gets the credit, otherwise everyone waiting on the enemy does
+			QuestObjectives->NotifyEnemyKilled(Result.Target, Cast<ARPGPluginCharacter>(Result.Source));
+		}
+	}
+
+	OnDamageResolved.Broadcast(Results);
+
+	UE_LOG(LogTemp, Verbose, TEXT("[UDamageQueueSubsystem::ResolveDamage] %d hits on %d targets, %d killed"), Hits.Num(), Results.Num(), NumKilled);
+}
@@ -0,0 +1,94 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "DamageQueueSubsystem.generated.h"
+
+UENUM(BlueprintType)
+enum class EDamageKind : uint8
+{
+	E_Default		UMETA(DisplayName = "DEFAULT"),		// Armor absorbs it first
+	E_Piercing		UMETA(DisplayName = "PIERCING")		// Straight to health
+};
+
+// Damage a target took on one frame, all its hits summed
+struct FDamageResult
+{
+	AActor* Target = nullptr;
+
+	// Source of the last hit, it gets the credit for the kill
+	AActor* Source = nullptr;
+
+	float Damage = 0.0f;
+
+	int32 NumHits = 0;
+
+	bool bKilled = false;
+};
+
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnDamageResolvedDelegate, TArrayView<const FDamageResult> /* Results */);
+
+/**
+ * Queues the hits of the frame and resolves them together once per frame.
+ * Hits are grouped by target, so an area attack on many enemies or many hits on the player only touch each target
+ * once: armor, health clamping and death are applied on the summed damage, which gives the same result as applying
+ * the hits one by one. Hit and death notifications go out afterwards, in bulk, through OnDamageResolved.
+ */
+UCLASS()
+class RPGPLUGIN_API UDamageQueueSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+
+	virtual void Deinitialize() override;
+
+	virtual void Tick(float DeltaTime) override;
+
+	virtual TStatId GetStatId() const override;
+
+	// Health and armor of the target change when the queue is resolved, at the end of the frame
+	UFUNCTION(BlueprintCallable, Category = "Damage")
+		void QueueDamage(AActor* Source, AActor* Target, float Amount, EDamageKind Kind = EDamageKind::E_Default);
+
+	// Resolves the queued hits now instead of at the end of the frame
+	void ResolveDamage();
+
+	int32 GetNumQueued() const { return Queue.Num(); }
+
+	// Every target hit on the frame, once resolved
+	FOnDamageResolvedDelegate OnDamageResolved;
+
+protected:
+
+	struct FQueuedDamage
+	{
+		TWeakObjectPtr<AActor> Source;
+
+		TWeakObjectPtr<AActor> Target;
+
+		float Amount;
+
+		EDamageKind Kind;
+	};
+
+	TArray<FQueuedDamage> Queue;
+
+	// Reused between frames
+	struct FResolvingHit
+	{
+		AActor* Target;
+
+		AActor* Source;
+
+		float ArmoredDamage;
+
+		float PiercingDamage;
+	};
+
+	TArray<FResolvingHit> Hits;
+
+	TArray<FDamageResult> Results;
+};
@@ -2,6 +2,11 @@
 
 
 #include "DefaultEnemy.h"
+#include "QuestObjectiveSubsystem.h"
+#include "TickSignificanceSubsystem.h"
+#include "EnemyCrowdSubsystem.h"
+#include "DamageQueueSubsystem.h"
+#include "RPGPluginCharacter.h"
 
 // Sets default values
 ADefaultEnemy::ADefaultEnemy()
@@ -9,6 +14,11 @@ ADefaultEnemy::ADefaultEnemy()
 	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
 	PrimaryActorTick.bCanEverTick = true;
 
+	joinCrowd = false;
+	moveSpeed = 300.0f;
+	aggroRadius = 2000.0f;
+	attackRange = 150.0f;
+	corpseTime = 5.0f;
 }
 
 // Called when the game starts or when spawned
@@ -18,26 +28,123 @@ void ADefaultEnemy::BeginPlay()
 
 	//Set the defaults for the variables
 	health = 1.0f;
+
+	TickSignificance = GetWorld()->GetSubsystem<UTickSignificanceSubsystem>();
+
+	// Hidden pooled proxies don't tick
+	if ((TickSignificance != nullptr) && !IsHidden())
+	{
+		TickSignificance->RegisterActor(this);
+	}
+
+	// Proxies spawned by the crowd already have a handle
+	if (joinCrowd && (CrowdHandle == INDEX_NONE))
+	{
+		if (UEnemyCrowdSubsystem* EnemyCrowd = GetWorld()->GetSubsystem<UEnemyCrowdSubsystem>())
+		{
+			EnemyCrowd->AddEnemy(this, health);
+		}
+	}
+}
+
+void ADefaultEnemy::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UEnemyCrowdSubsystem* EnemyCrowd = GetWorld()->GetSubsystem<UEnemyCrowdSubsystem>())
+	{
+		EnemyCrowd->NotifyProxyEndPlay(this);
+	}
+
+	if (TickSignificance != nullptr)
+	{
+		TickSignificance->UnregisterActor(this);
+		TickSignificance = nullptr;
+	}
+
+	Super::EndPlay(EndPlayReason);
 }
 
 // Called every frame
 void ADefaultEnemy::Tick(float DeltaTime)
 {
+	FSignificanceTickScope SignificanceScope(TickSignificance);
+
 	Super::Tick(DeltaTime);
 
 }
 
-void ADefaultEnemy::TakeDamage(float _damage)
+void ADefaultEnemy::TakeDamage(float _damage, AActor* _source)
 {
-	health -= _damage;
+	if (UDamageQueueSubsystem* DamageQueue = GetWorld()->GetSubsystem<UDamageQueueSubsystem>())
+	{
+		DamageQueue->QueueDamage(_source, this, _damage);
+		return;
+	}
 
-	if (health <= 0.0f)
+	if (ResolveDamage(_damage, _source))
 	{
-		isDead = true;
+		// Only the objectives waiting on this enemy class are touched
+		if (UQuestObjectiveSubsystem* QuestObjectives = GetWorld()->GetSubsystem<UQuestObjectiveSubsystem>())
+		{
+			QuestObjectives->NotifyEnemyKilled(this, Cast<ARPGPluginCharacter>(_source));
+		}
 	}
-	else
+}
+
+bool ADefaultEnemy::ResolveDamage(float Damage, AActor* Source)
+{
+	// The crowd owns the health of its enemies and reports their deaths, the proxy gets it back on the next sync
+	if (CrowdHandle != INDEX_NONE)
+	{
+		if (UEnemyCrowdSubsystem* EnemyCrowd = GetWorld()->GetSubsystem<UEnemyCrowdSubsystem>())
+		{
+			EnemyCrowd->DamageEnemy(CrowdHandle, Damage, Source);
+			return false;
+		}
+	}
+
+	if (isDead) return false;
+
+	health = FMath::Max(health - Damage, 0.0f);
+
+	if (health > 0.0f)
 	{
 		hasTakenDamage = true;
+		return false;
 	}
+
+	isDead = true;
+	return true;
 }
 
+void ADefaultEnemy::SetCrowdHandle(int32 Handle)
+{
+	const bool bShown = (Handle != INDEX_NONE);
+
+	CrowdHandle = Handle;
+
+	SetActorHiddenInGame(!bShown);
+	SetActorEnableCollision(bShown);
+	SetActorTickEnabled(bShown);
+
+	// Before BeginPlay the subsystem isn't cached yet, BeginPlay registers
+	if (TickSignificance != nullptr)
+	{
+		if (bShown)
+		{
+			TickSignificance->RegisterActor(this);
+		}
+		else
+		{
+			TickSignificance->UnregisterActor(this);
+		}
+	}
+}
+
+void ADefaultEnemy::ApplyCrowdState(const FVector& Location, float Yaw, float InHealth, bool bDamaged, bool bDead)
+{
+	SetActorLocationAndRotation(Location, FRotator(0.0f, Yaw, 0.0f));
+
+	health = InHealth;
+	hasTakenDamage = bDamaged;
+	isDead = bDead;
+}
@@ -11,6 +11,8 @@ class RPGPLUGIN_API ADefaultEnemy : public AActor
 {
 	GENERATED_BODY()
 
+	friend class UEnemyCrowdSubsystem;
+
 public:
 	// Sets default values for this actor's properties
 	ADefaultEnemy();
@@ -19,8 +21,12 @@ protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	// Queued and resolved with the other hits of the frame, see UDamageQueueSubsystem.
+	// A character source gets the credit if it kills, without one every character waiting on the enemy does
 	UFUNCTION(BlueprintCallable)
-		void TakeDamage(float _damage);
+		void TakeDamage(float _damage, AActor* _source = nullptr);
 
 	//The current health of the player
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Enemy)
@@ -34,8 +40,43 @@ protected:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Enemy)
 		bool isDead;
 
+	//Simulate the enemy in the enemy crowd, the actor only shows it while it is near the player
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Enemy|Crowd")
+		bool joinCrowd;
+
+	//Speed the crowd enemy chases the player at
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Enemy|Crowd")
+		float moveSpeed;
+
+	//Distance the crowd enemy notices the player from
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Enemy|Crowd")
+		float aggroRadius;
+
+	//Distance the crowd enemy stops at from the player
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Enemy|Crowd")
+		float attackRange;
+
+	//Time the dead crowd enemy stays before being removed
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Enemy|Crowd")
+		float corpseTime;
+
+	// Called by the crowd when the actor starts or stops showing a crowd enemy, INDEX_NONE hides it
+	void SetCrowdHandle(int32 Handle);
+
+	void ApplyCrowdState(const FVector& Location, float Yaw, float InHealth, bool bDamaged, bool bDead);
+
+	// Crowd enemy this actor is the proxy of
+	int32 CrowdHandle = INDEX_NONE;
+
+	// Decides how often this actor ticks, see UTickSignificanceSubsystem
+	UPROPERTY(Transient)
+		class UTickSignificanceSubsystem* TickSignificance = nullptr;
+
 public:
 	// Called every frame
 	virtual void Tick(float DeltaTime) override;
 
+	// Applies the summed damage of a frame. Returns true if it killed the enemy
+	bool ResolveDamage(float Damage, AActor* Source = nullptr);
+
 };
@@ -2,6 +2,7 @@
 
 
 #include "DefaultWeapon.h"
+#include "TickSignificanceSubsystem.h"
 
 // Sets default values
 ADefaultWeapon::ADefaultWeapon()
@@ -21,11 +22,30 @@ void ADefaultWeapon::BeginPlay()
 {
 	Super::BeginPlay();
 
+	TickSignificance = GetWorld()->GetSubsystem<UTickSignificanceSubsystem>();
+
+	if (TickSignificance != nullptr)
+	{
+		TickSignificance->RegisterActor(this);
+	}
+}
+
+void ADefaultWeapon::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (TickSignificance != nullptr)
+	{
+		TickSignificance->UnregisterActor(this);
+		TickSignificance = nullptr;
+	}
+
+	Super::EndPlay(EndPlayReason);
 }
 
 // Called every frame
 void ADefaultWeapon::Tick(float DeltaTime)
 {
+	FSignificanceTickScope SignificanceScope(TickSignificance);
+
 	Super::Tick(DeltaTime);
 
 }
@@ -28,6 +28,8 @@ protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 	// The level requirement to use the weapon
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Weapon")
 		int levelReq;
@@ -44,8 +46,16 @@ protected:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Weapon")
 		EWeaponType weaponType;
 
+	// Decides how often this actor ticks, see UTickSignificanceSubsystem
+	UPROPERTY(Transient)
+		class UTickSignificanceSubsystem* TickSignificance = nullptr;
+
 public:
 	// Called every frame
 	virtual void Tick(float DeltaTime) override;
 
+	float GetBaseDamage() const { return baseDamage; }
+
+	float GetBaseSpeed() const { return baseSpeed; }
+
 };
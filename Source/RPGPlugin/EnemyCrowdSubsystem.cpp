@@ -0,0 +1,575 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "EnemyCrowdSubsystem.h"
+#include "RPGPlugin.h"
+#include "DefaultEnemy.h"
+#include "QuestObjectiveSubsystem.h"
+#include "RPGPluginCharacter.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerController.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "Async/ParallelFor.h"
+#include "Math/RandomStream.h"
+
+DECLARE_CYCLE_STAT(TEXT("Enemy Crowd Simulate"), STAT_EnemyCrowdSimulate, STATGROUP_RPGPlugin);
+DECLARE_CYCLE_STAT(TEXT("Enemy Crowd Proxies"), STAT_EnemyCrowdProxies, STATGROUP_RPGPlugin);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Enemy Crowd Enemies"), STAT_EnemyCrowdEnemies, STATGROUP_RPGPlugin);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Enemy Crowd Proxies"), STAT_EnemyCrowdNumProxies, STATGROUP_RPGPlugin);
+
+static TAutoConsoleVariable<int32> CVarCrowdParallelBatchSize(
+	TEXT("rpg.Crowd.ParallelBatchSize"),
+	256,
+	TEXT("Enemies per worker task in the behaviour pass. 0 runs the pass on the game thread."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarCrowdProxyRadius(
+	TEXT("rpg.Crowd.ProxyRadius"),
+	5000.0f,
+	TEXT("Crowd enemies closer than this to a player are shown by an actor. They lose it 20% farther."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarCrowdProxyInterval(
+	TEXT("rpg.Crowd.ProxyInterval"),
+	0.1f,
+	TEXT("Seconds between the checks giving and taking proxies."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarCrowdMaxProxySpawns(
+	TEXT("rpg.Crowd.MaxProxySpawns"),
+	8,
+	TEXT("Proxy actors spawned per check at most, the pool is used first."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarCrowdMaxFreeProxies(
+	TEXT("rpg.Crowd.MaxFreeProxies"),
+	32,
+	TEXT("Hidden proxies kept for reuse, the rest are destroyed."),
+	ECVF_Default);
+
+// Time an enemy is staggered after a hit
+static const float CrowdHitStunTime = 0.5f;
+
+
+//// FEnemyCrowd ///////
+
+int32 FEnemyCrowd::Add(int32 ClassIndex, const FVector& Location, float InHealth)
+{
+	Health.Add(InHealth);
+	HitTimers.Add(0.0f);
+	CorpseTimers.Add(0.0f);
+	PositionX.Add(Location.X);
+	PositionY.Add(Location.Y);
+	PositionZ.Add(Location.Z);
+	Yaw.Add(0.0f);
+	Flags.Add(Alive);
+
+	return ClassIndices.Add(static_cast<uint16>(ClassIndex));
+}
+
+void FEnemyCrowd::RemoveAtSwap(int32 Slot)
+{
+	Health.RemoveAtSwap(Slot, 1, false);
+	HitTimers.RemoveAtSwap(Slot, 1, false);
+	CorpseTimers.RemoveAtSwap(Slot, 1, false);
+	PositionX.RemoveAtSwap(Slot, 1, false);
+	PositionY.RemoveAtSwap(Slot, 1, false);
+	PositionZ.RemoveAtSwap(Slot, 1, false);
+	Yaw.RemoveAtSwap(Slot, 1, false);
+	Flags.RemoveAtSwap(Slot, 1, false);
+	ClassIndices.RemoveAtSwap(Slot, 1, false);
+}
+
+void FEnemyCrowd::ApplyDamage(int32 Slot, float Damage)
+{
+	if (!IsAlive(Slot)) return;
+
+	Health[Slot] = FMath::Max(Health[Slot] - Damage, 0.0f);
+	HitTimers[Slot] = CrowdHitStunTime;
+	Flags[Slot] |= Damaged;
+}
+
+void FEnemyCrowd::UpdateTimers(float DeltaTime)
+{
+	const int32 Count = Num();
+	float* RESTRICT Hit = HitTimers.GetData();
+	float* RESTRICT Corpse = CorpseTimers.GetData();
+
+	for (int32 i = 0; i < Count; i++)
+	{
+		Hit[i] = FMath::Max(Hit[i] - DeltaTime, 0.0f);
+		Corpse[i] = FMath::Max(Corpse[i] - DeltaTime, 0.0f);
+	}
+}
+
+void FEnemyCrowd::CollectDeaths(TArray<int32>& OutSlots)
+{
+	const int32 Count = Num();
+
+	for (int32 i = 0; i < Count; i++)
+	{
+		if ((Health[i] <= 0.0f) && ((Flags[i] & Alive) != 0))
+		{
+			Flags[i] &= ~(Alive | Chasing);
+			CorpseTimers[i] = ClassParams[ClassIndices[i]].CorpseTime;
+
+			OutSlots.Add(i);
+		}
+	}
+}
+
+void FEnemyCrowd::CollectExpired(TArray<int32>& OutSlots) const
+{
+	const int32 Count = Num();
+
+	for (int32 i = 0; i < Count; i++)
+	{
+		if (((Flags[i] & Alive) == 0) && (CorpseTimers[i] <= 0.0f))
+		{
+			OutSlots.Add(i);
+		}
+	}
+}
+
+void FEnemyCrowd::UpdateBehaviour(int32 Begin, int32 End, float DeltaTime, TArrayView<const FVector> Targets)
+{
+	for (int32 i = Begin; i < End; i++)
+	{
+		if (((Flags[i] & Alive) == 0) || (HitTimers[i] > 0.0f))
+		{
+			Flags[i] &= ~Chasing;
+			continue;
+		}
+
+		const FEnemyCrowdClassParams& Params = ClassParams[ClassIndices[i]];
+
+		// Nearest target on the ground plane, there are only a few of them
+		float BestDX = 0.0f;
+		float BestDY = 0.0f;
+		float BestDistanceSquared = FMath::Square(Params.AggroRadius);
+		bool bFound = false;
+
+		for (const FVector& Target : Targets)
+		{
+			const float DX = Target.X - PositionX[i];
+			const float DY = Target.Y - PositionY[i];
+			const float DistanceSquared = DX * DX + DY * DY;
+
+			if (DistanceSquared < BestDistanceSquared)
+			{
+				BestDX = DX;
+				BestDY = DY;
+				BestDistanceSquared = DistanceSquared;
+				bFound = true;
+			}
+		}
+
+		if (!bFound)
+		{
+			Flags[i] &= ~Chasing;
+			continue;
+		}
+
+		Flags[i] |= Chasing;
+
+		const float Distance = FMath::Sqrt(BestDistanceSquared);
+		const float Step = FMath::Min(Params.MoveSpeed * DeltaTime, Distance - Params.AttackRange);
+
+		if ((Step > 0.0f) && (Distance > KINDA_SMALL_NUMBER))
+		{
+			PositionX[i] += BestDX / Distance * Step;
+			PositionY[i] += BestDY / Distance * Step;
+		}
+
+		Yaw[i] = FMath::RadiansToDegrees(FMath::Atan2(BestDY, BestDX));
+	}
+}
+
+
+//// UEnemyCrowdSubsystem ///////
+
+void UEnemyCrowdSubsystem::Deinitialize()
+{
+	Crowd = FEnemyCrowd();
+	Classes.Empty();
+	Proxies.Empty();
+	FreeProxies.Empty();
+	SlotHandles.Empty();
+	HandleSlots.Empty();
+	FreeHandles.Empty();
+	PendingDamage.Empty();
+	LastHitters.Empty();
+
+	SET_DWORD_STAT(STAT_EnemyCrowdEnemies, 0);
+	SET_DWORD_STAT(STAT_EnemyCrowdNumProxies, 0);
+
+	Super::Deinitialize();
+}
+
+TStatId UEnemyCrowdSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UEnemyCrowdSubsystem, STATGROUP_Tickables);
+}
+
+int32 UEnemyCrowdSubsystem::SpawnEnemy(TSubclassOf<ADefaultEnemy> EnemyClass, const FVector& Location, float InHealth)
+{
+	if (EnemyClass == nullptr) return INDEX_NONE;
+
+	const int32 Slot = AddSlot(EnemyClass, Location, InHealth);
+
+	return SlotHandles[Slot];
+}
+
+int32 UEnemyCrowdSubsystem::AddEnemy(ADefaultEnemy* Enemy, float InHealth)
+{
+	if ((Enemy == nullptr) || (Enemy->CrowdHandle != INDEX_NONE)) return INDEX_NONE;
+
+	const int32 Slot = AddSlot(Enemy->GetClass(), Enemy->GetActorLocation(), InHealth);
+
+	Crowd.Yaw[Slot] = Enemy->GetActorRotation().Yaw;
+
+	Proxies[Slot] = Enemy;
+	Enemy->SetCrowdHandle(SlotHandles[Slot]);
+
+	return SlotHandles[Slot];
+}
+
+void UEnemyCrowdSubsystem::DamageEnemy(int32 Handle, float Damage, AActor* Source)
+{
+	if (!HandleSlots.IsValidIndex(Handle) || (HandleSlots[Handle] == INDEX_NONE)) return;
+
+	PendingDamage.Add({ Handle, Damage, Source });
+}
+
+bool UEnemyCrowdSubsystem::IsEnemyAlive(int32 Handle) const
+{
+	if (!HandleSlots.IsValidIndex(Handle) || (HandleSlots[Handle] == INDEX_NONE)) return false;
+
+	return Crowd.IsAlive(HandleSlots[Handle]);
+}
+
+void UEnemyCrowdSubsystem::NotifyProxyEndPlay(ADefaultEnemy* Proxy)
+{
+	FreeProxies.RemoveSwap(Proxy);
+
+	const int32 Handle = Proxy->CrowdHandle;
+
+	if (HandleSlots.IsValidIndex(Handle) && (HandleSlots[Handle] != INDEX_NONE) && (Proxies[HandleSlots[Handle]] == Proxy))
+	{
+		// The enemy keeps living, it gets a new proxy on the next check if it is still near a player
+		Proxies[HandleSlots[Handle]] = nullptr;
+	}
+}
+
+int32 UEnemyCrowdSubsystem::GetClassIndex(UClass* EnemyClass)
+{
+	int32 ClassIndex = Classes.Find(EnemyClass);
+
+	if (ClassIndex == INDEX_NONE)
+	{
+		const ADefaultEnemy* Defaults = EnemyClass->GetDefaultObject<ADefaultEnemy>();
+
+		FEnemyCrowdClassParams& Params = Crowd.ClassParams.AddDefaulted_GetRef();
+		Params.MoveSpeed = Defaults->moveSpeed;
+		Params.AggroRadius = Defaults->aggroRadius;
+		Params.AttackRange = Defaults->attackRange;
+		Params.CorpseTime = Defaults->corpseTime;
+
+		ClassIndex = Classes.Add(EnemyClass);
+	}
+
+	return ClassIndex;
+}
+
+int32 UEnemyCrowdSubsystem::AddSlot(UClass* EnemyClass, const FVector& Location, float InHealth)
+{
+	const int32 Slot = Crowd.Add(GetClassIndex(EnemyClass), Location, InHealth);
+
+	const int32 Handle = (FreeHandles.Num() > 0) ? FreeHandles.Pop(false) : HandleSlots.AddUninitialized();
+	HandleSlots[Handle] = Slot;
+
+	SlotHandles.Add(Handle);
+	Proxies.Add(nullptr);
+	LastHitters.AddDefaulted();
+
+	SET_DWORD_STAT(STAT_EnemyCrowdEnemies, Crowd.Num());
+
+	return Slot;
+}
+
+void UEnemyCrowdSubsystem::RemoveSlot(int32 Slot)
+{
+	ReleaseProxy(Slot);
+
+	const int32 Handle = SlotHandles[Slot];
+	HandleSlots[Handle] = INDEX_NONE;
+	FreeHandles.Add(Handle);
+
+	Crowd.RemoveAtSwap(Slot);
+	Proxies.RemoveAtSwap(Slot, 1, false);
+	LastHitters.RemoveAtSwap(Slot, 1, false);
+	SlotHandles.RemoveAtSwap(Slot, 1, false);
+
+	// The last enemy moved into the slot
+	if (SlotHandles.IsValidIndex(Slot))
+	{
+		HandleSlots[SlotHandles[Slot]] = Slot;
+	}
+
+	SET_DWORD_STAT(STAT_EnemyCrowdEnemies, Crowd.Num());
+}
+
+void UEnemyCrowdSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	{
+		SCOPE_CYCLE_COUNTER(STAT_EnemyCrowdSimulate);
+
+		ResolveDamage();
+
+		ResolveDeaths();
+
+		Crowd.UpdateTimers(DeltaTime);
+
+		SimulateBehaviour(DeltaTime);
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_EnemyCrowdProxies);
+
+	TimeSinceProxyUpdate += DeltaTime;
+
+	if (TimeSinceProxyUpdate >= CVarCrowdProxyInterval.GetValueOnGameThread())
+	{
+		TimeSinceProxyUpdate = 0.0f;
+
+		UpdateProxies();
+	}
+
+	SyncProxies();
+}
+
+void UEnemyCrowdSubsystem::ResolveDamage()
+{
+	for (const FPendingDamage& Pending : PendingDamage)
+	{
+		// The enemy may have been removed since
+		const int32 Slot = HandleSlots.IsValidIndex(Pending.Handle) ? HandleSlots[Pending.Handle] : INDEX_NONE;
+
+		if ((Slot != INDEX_NONE) && Crowd.IsAlive(Slot))
+		{
+			Crowd.ApplyDamage(Slot, Pending.Damage);
+
+			// Hits from anything else don't take the credit away from the last character
+			if (ARPGPluginCharacter* Character = Cast<ARPGPluginCharacter>(Pending.Source.Get()))
+			{
+				LastHitters[Slot] = Character;
+			}
+		}
+	}
+
+	PendingDamage.Reset();
+}
+
+void UEnemyCrowdSubsystem::ResolveDeaths()
+{
+	SlotsScratch.Reset();
+	Crowd.CollectDeaths(SlotsScratch);
+
+	UQuestObjectiveSubsystem* QuestObjectives = GetWorld()->GetSubsystem<UQuestObjectiveSubsystem>();
+
+	if (QuestObjectives != nullptr)
+	{
+		for (int32 Slot : SlotsScratch)
+		{
+			// Same event as an enemy with its own actor. Without a character hit, everyone waiting on it gets the credit
+			QuestObjectives->NotifyEnemyKilled(Classes[Crowd.ClassIndices[Slot]], LastHitters[Slot].Get());
+		}
+	}
+
+	// Corpses that were shown long enough, highest slot first so the swaps don't move the ones left to remove
+	SlotsScratch.Reset();
+	Crowd.CollectExpired(SlotsScratch);
+
+	for (int32 i = SlotsScratch.Num() - 1; i >= 0; i--)
+	{
+		RemoveSlot(SlotsScratch[i]);
+	}
+}
+
+void UEnemyCrowdSubsystem::SimulateBehaviour(float DeltaTime)
+{
+	PlayerLocations.Reset();
+
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		const APawn* Pawn = It->IsValid() ? (*It)->GetPawn() : nullptr;
+
+		if (Pawn != nullptr)
+		{
+			PlayerLocations.Add(Pawn->GetActorLocation());
+		}
+	}
+
+	const int32 Count = Crowd.Num();
+	const int32 BatchSize = CVarCrowdParallelBatchSize.GetValueOnGameThread();
+
+	if ((BatchSize <= 0) || (Count <= BatchSize))
+	{
+		Crowd.UpdateBehaviour(0, Count, DeltaTime, PlayerLocations);
+		return;
+	}
+
+	const int32 NumBatches = FMath::DivideAndRoundUp(Count, BatchSize);
+
+	ParallelFor(NumBatches, [this, Count, BatchSize, DeltaTime](int32 Batch)
+	{
+		const int32 Begin = Batch * BatchSize;
+		Crowd.UpdateBehaviour(Begin, FMath::Min(Begin + BatchSize, Count), DeltaTime, PlayerLocations);
+	});
+}
+
+void UEnemyCrowdSubsystem::UpdateProxies()
+{
+	const float ShowRadiusSquared = FMath::Square(CVarCrowdProxyRadius.GetValueOnGameThread());
+	const float HideRadiusSquared = ShowRadiusSquared * FMath::Square(1.2f);
+	int32 SpawnsLeft = CVarCrowdMaxProxySpawns.GetValueOnGameThread();
+
+	for (int32 Slot = 0; Slot < Crowd.Num(); Slot++)
+	{
+		float DistanceSquared = MAX_flt;
+
+		for (const FVector& Location : PlayerLocations)
+		{
+			DistanceSquared = FMath::Min(DistanceSquared, FVector::DistSquared(Location, Crowd.GetLocation(Slot)));
+		}
+
+		if (Proxies[Slot] == nullptr)
+		{
+			if (DistanceSquared > ShowRadiusSquared) continue;
+
+			// Pooled proxies are cheap, spawning is limited per check
+			const bool bPooled = FreeProxies.ContainsByPredicate([this, Slot](const ADefaultEnemy* Proxy)
+			{
+				return (Proxy != nullptr) && (Proxy->GetClass() == Classes[Crowd.ClassIndices[Slot]]);
+			});
+
+			if (bPooled || (SpawnsLeft-- > 0))
+			{
+				AttachProxy(Slot);
+			}
+		}
+		else if (DistanceSquared > HideRadiusSquared)
+		{
+			ReleaseProxy(Slot);
+		}
+	}
+
+	int32 NumProxies = 0;
+
+	for (const ADefaultEnemy* Proxy : Proxies)
+	{
+		NumProxies += (Proxy != nullptr) ? 1 : 0;
+	}
+
+	SET_DWORD_STAT(STAT_EnemyCrowdNumProxies, NumProxies);
+}
+
+void UEnemyCrowdSubsystem::SyncProxies()
+{
+	for (int32 Slot = 0; Slot < Crowd.Num(); Slot++)
+	{
+		ADefaultEnemy* Proxy = Proxies[Slot];
+
+		if (Proxy != nullptr)
+		{
+			const uint8 Flags = Crowd.Flags[Slot];
+
+			Proxy->ApplyCrowdState(Crowd.GetLocation(Slot), Crowd.Yaw[Slot], Crowd.Health[Slot],
+				(Flags & FEnemyCrowd::Damaged) != 0, (Flags & FEnemyCrowd::Alive) == 0);
+		}
+	}
+}
+
+void UEnemyCrowdSubsystem::AttachProxy(int32 Slot)
+{
+	UClass* EnemyClass = Classes[Crowd.ClassIndices[Slot]];
+	const FTransform Transform(FRotator(0.0f, Crowd.Yaw[Slot], 0.0f), Crowd.GetLocation(Slot));
+
+	const int32 FreeIndex = FreeProxies.FindLastByPredicate([EnemyClass](const ADefaultEnemy* Proxy)
+	{
+		return (Proxy != nullptr) && (Proxy->GetClass() == EnemyClass);
+	});
+
+	ADefaultEnemy* Proxy = nullptr;
+
+	if (FreeIndex != INDEX_NONE)
+	{
+		Proxy = FreeProxies[FreeIndex];
+		FreeProxies.RemoveAtSwap(FreeIndex, 1, false);
+
+		Proxy->SetActorTransform(Transform);
+		Proxy->SetCrowdHandle(SlotHandles[Slot]);
+	}
+	else
+	{
+		// The handle is set before BeginPlay so the proxy doesn't join the crowd as a new enemy
+		Proxy = GetWorld()->SpawnActorDeferred<ADefaultEnemy>(EnemyClass, Transform, nullptr, nullptr, ESpawnActorCollisionHandlingMethod::AlwaysSpawn);
+
+		if (Proxy == nullptr) return;
+
+		Proxy->SetCrowdHandle(SlotHandles[Slot]);
+		Proxy->FinishSpawning(Transform);
+	}
+
+	Proxies[Slot] = Proxy;
+}
+
+void UEnemyCrowdSubsystem::ReleaseProxy(int32 Slot)
+{
+	ADefaultEnemy* Proxy = Proxies[Slot];
+	if (Proxy == nullptr) return;
+
+	Proxies[Slot] = nullptr;
+
+	Proxy->SetCrowdHandle(INDEX_NONE);
+
+	if (FreeProxies.Num() < CVarCrowdMaxFreeProxies.GetValueOnGameThread())
+	{
+		FreeProxies.Add(Proxy);
+	}
+	else
+	{
+		Proxy->Destroy();
+	}
+}
+
+
+//// Console ///////
+
+// rpg.Crowd.Spawn [Count] [Radius]: crowd enemies scattered around the first player
+static FAutoConsoleCommandWithWorldAndArgs CrowdSpawnCommand(
+	TEXT("rpg.Crowd.Spawn"),
+	TEXT("Spawns crowd enemies around the player. Args: [Count=2000] [Radius=10000]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic([](const TArray<FString>& Args, UWorld* World)
+	{
+		const int32 Count = (Args.Num() > 0) ? FCString::Atoi(*Args[0]) : 2000;
+		const float Radius = (Args.Num() > 1) ? FCString::Atof(*Args[1]) : 10000.0f;
+
+		UEnemyCrowdSubsystem* EnemyCrowd = (World != nullptr) ? World->GetSubsystem<UEnemyCrowdSubsystem>() : nullptr;
+		APlayerController* PlayerController = (World != nullptr) ? World->GetFirstPlayerController() : nullptr;
+		const APawn* Pawn = (PlayerController != nullptr) ? PlayerController->GetPawn() : nullptr;
+
+		if ((EnemyCrowd == nullptr) || (Pawn == nullptr) || (Count <= 0)) return;
+
+		FRandomStream Random(42);
+
+		for (int32 i = 0; i < Count; i++)
+		{
+			const FVector2D Offset = FVector2D(Random.FRandRange(-1.0f, 1.0f), Random.FRandRange(-1.0f, 1.0f)) * Radius;
+			EnemyCrowd->SpawnEnemy(ADefaultEnemy::StaticClass(), Pawn->GetActorLocation() + FVector(Offset, 0.0f));
+		}
+
+		UE_LOG(LogTemp, Display, TEXT("[rpg.Crowd.Spawn] %d enemies, %d in the crowd"), Count, EnemyCrowd->GetNumEnemies());
+	}));
@@ -0,0 +1,188 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "EnemyCrowdSubsystem.generated.h"
+
+class ADefaultEnemy;
+class ARPGPluginCharacter;
+
+// Tuning shared by every enemy of a class, read from the class defaults
+struct FEnemyCrowdClassParams
+{
+	float MoveSpeed = 300.0f;
+
+	float AggroRadius = 2000.0f;
+
+	float AttackRange = 150.0f;
+
+	float CorpseTime = 5.0f;
+};
+
+/**
+ * Simulation state of a crowd of enemies in structure-of-arrays form.
+ * Each field lives in its own contiguous array indexed by slot and each pass only walks the arrays it needs,
+ * so the loops are plain arithmetic over floats that the compiler can vectorize and that can be split across
+ * workers. Slots are dense: removing one moves the last enemy into it.
+ */
+class RPGPLUGIN_API FEnemyCrowd
+{
+public:
+
+	enum EFlags : uint8
+	{
+		Alive = 1 << 0,
+		Damaged = 1 << 1,	// Hit at least once, like hasTakenDamage
+		Chasing = 1 << 2,
+	};
+
+	int32 Add(int32 ClassIndex, const FVector& Location, float InHealth);
+
+	void RemoveAtSwap(int32 Slot);
+
+	int32 Num() const { return Health.Num(); }
+
+	FVector GetLocation(int32 Slot) const { return FVector(PositionX[Slot], PositionY[Slot], PositionZ[Slot]); }
+
+	bool IsAlive(int32 Slot) const { return (Flags[Slot] & Alive) != 0; }
+
+	// Deaths are picked up by CollectDeaths
+	void ApplyDamage(int32 Slot, float Damage);
+
+	void UpdateTimers(float DeltaTime);
+
+	// Slots that died since the last call, they stay in the crowd as corpses until CollectExpired
+	void CollectDeaths(TArray<int32>& OutSlots);
+
+	void CollectExpired(TArray<int32>& OutSlots) const;
+
+	// Enemies chase the nearest target in their aggro radius, slots [Begin, End). Slots don't share any state,
+	// so separate ranges can run on separate threads
+	void UpdateBehaviour(int32 Begin, int32 End, float DeltaTime, TArrayView<const FVector> Targets);
+
+	TArray<FEnemyCrowdClassParams> ClassParams;
+
+	TArray<float> Health;
+
+	// Time left staggered by the last hit, the enemy doesn't move meanwhile
+	TArray<float> HitTimers;
+
+	// Time left before a dead enemy is removed
+	TArray<float> CorpseTimers;
+
+	TArray<float> PositionX;
+
+	TArray<float> PositionY;
+
+	TArray<float> PositionZ;
+
+	TArray<float> Yaw;
+
+	TArray<uint8> Flags;
+
+	TArray<uint16> ClassIndices;
+};
+
+/**
+ * Simulates large numbers of enemies without an actor each.
+ * The state of every enemy lives in an FEnemyCrowd and is updated in batched passes each frame: pending damage,
+ * deaths, timers, then behaviour, spread over worker threads with ParallelFor. ADefaultEnemy actors are only thin
+ * visual proxies: enemies within rpg.Crowd.ProxyRadius of a player get one, taken from a pool, and the proxy
+ * mirrors the position, health and flags of its enemy.
+ */
+UCLASS()
+class RPGPLUGIN_API UEnemyCrowdSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+
+	virtual void Deinitialize() override;
+
+	virtual void Tick(float DeltaTime) override;
+
+	virtual TStatId GetStatId() const override;
+
+	// Returns the handle for the calls below. Handles are reused once an enemy is removed
+	int32 SpawnEnemy(TSubclassOf<ADefaultEnemy> EnemyClass, const FVector& Location, float InHealth = 1.0f);
+
+	// Takes over a placed enemy, the actor becomes the proxy of the new crowd enemy
+	int32 AddEnemy(ADefaultEnemy* Enemy, float InHealth);
+
+	// Applied with the other damage of the frame on the next tick. A character source gets the credit if it kills
+	void DamageEnemy(int32 Handle, float Damage, AActor* Source = nullptr);
+
+	bool IsEnemyAlive(int32 Handle) const;
+
+	// The proxy is being destroyed by someone else, forget it
+	void NotifyProxyEndPlay(ADefaultEnemy* Proxy);
+
+	int32 GetNumEnemies() const { return Crowd.Num(); }
+
+protected:
+
+	int32 GetClassIndex(UClass* EnemyClass);
+
+	int32 AddSlot(UClass* EnemyClass, const FVector& Location, float InHealth);
+
+	void RemoveSlot(int32 Slot);
+
+	void ResolveDamage();
+
+	void ResolveDeaths();
+
+	void SimulateBehaviour(float DeltaTime);
+
+	// Gives proxies to the enemies near a player and takes them from the ones that left
+	void UpdateProxies();
+
+	void SyncProxies();
+
+	void AttachProxy(int32 Slot);
+
+	void ReleaseProxy(int32 Slot);
+
+	FEnemyCrowd Crowd;
+
+	// Indexed by FEnemyCrowd::ClassIndices
+	UPROPERTY(Transient)
+		TArray<UClass*> Classes;
+
+	// Indexed by slot, null for enemies away from the players
+	UPROPERTY(Transient)
+		TArray<ADefaultEnemy*> Proxies;
+
+	UPROPERTY(Transient)
+		TArray<ADefaultEnemy*> FreeProxies;
+
+	// Indexed by slot
+	TArray<int32> SlotHandles;
+
+	// Indexed by handle, INDEX_NONE once the enemy is removed
+	TArray<int32> HandleSlots;
+
+	TArray<int32> FreeHandles;
+
+	// Indexed by slot, the character credited with the kill
+	TArray<TWeakObjectPtr<ARPGPluginCharacter>> LastHitters;
+
+	struct FPendingDamage
+	{
+		int32 Handle;
+
+		float Damage;
+
+		TWeakObjectPtr<AActor> Source;
+	};
+
+	TArray<FPendingDamage> PendingDamage;
+
+	float TimeSinceProxyUpdate = 0.0f;
+
+	// Reused between frames
+	TArray<FVector> PlayerLocations;
+
+	TArray<int32> SlotsScratch;
+};
@@ -0,0 +1,433 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "InteractionGridSubsystem.h"
+#include "RPGPlugin.h"
+#include "BasicInteractive.h"
+#include "RPGPluginCharacter.h"
+#include "Components/CapsuleComponent.h"
+#include "GameFramework/PlayerController.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "Math/RandomStream.h"
+
+DECLARE_CYCLE_STAT(TEXT("Interaction Grid Query"), STAT_InteractionGridQuery, STATGROUP_RPGPlugin);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Interaction Grid Entries"), STAT_InteractionGridEntries, STATGROUP_RPGPlugin);
+
+static TAutoConsoleVariable<float> CVarInteractionQueryInterval(
+	TEXT("rpg.Interaction.QueryInterval"),
+	0.05f,
+	TEXT("Seconds between the interaction grid queries around the players. 0 queries every frame."),
+	ECVF_Default);
+
+
+//// FInteractionGrid ///////
+
+FInteractionGrid::FInteractionGrid(float InCellSize)
+	: CellSize(InCellSize)
+{
+}
+
+int32 FInteractionGrid::Add(const FTransform& BoxTransform, const FVector& BoxExtent)
+{
+	const int32 Handle = Entries.Add(FEntry());
+
+	FEntry& Entry = Entries[Handle];
+	Entry.BoxTransform = FTransform(BoxTransform.GetRotation(), BoxTransform.GetLocation());
+	Entry.BoxExtent = BoxExtent;
+
+	AddToCells(Handle);
+
+	return Handle;
+}
+
+void FInteractionGrid::Update(int32 Handle, const FTransform& BoxTransform, const FVector& BoxExtent)
+{
+	if (!Entries.IsValidIndex(Handle)) return;
+
+	RemoveFromCells(Handle);
+
+	FEntry& Entry = Entries[Handle];
+	Entry.BoxTransform = FTransform(BoxTransform.GetRotation(), BoxTransform.GetLocation());
+	Entry.BoxExtent = BoxExtent;
+
+	AddToCells(Handle);
+}
+
+void FInteractionGrid::Remove(int32 Handle)
+{
+	if (!Entries.IsValidIndex(Handle)) return;
+
+	RemoveFromCells(Handle);
+	Entries.RemoveAt(Handle);
+}
+
+void FInteractionGrid::Query(const FVector& Location, float Radius, float HalfHeight, TArray<int32>& OutHandles)
+{
+	OutHandles.Reset();
+	QueryStamp++;
+
+	// Overlaps grows the box by the capsule in the frame of the box. Rotated, that reaches farther than Radius
+	// along the world axes, but never farther than the length of the growth
+	const float Reach = FVector(Radius, Radius, HalfHeight).Size();
+
+	const FIntPoint MinCell = GetCell(Location - FVector(Reach, Reach, 0.0f));
+	const FIntPoint MaxCell = GetCell(Location + FVector(Reach, Reach, 0.0f));
+
+	for (int32 X = MinCell.X; X <= MaxCell.X; X++)
+	{
+		for (int32 Y = MinCell.Y; Y <= MaxCell.Y; Y++)
+		{
+			const TArray<int32>* Cell = Cells.Find(FIntPoint(X, Y));
+
+			if (Cell == nullptr) continue;
+
+			for (int32 Handle : *Cell)
+			{
+				FEntry& Entry = Entries[Handle];
+
+				if (Entry.QueryStamp == QueryStamp) continue;
+
+				Entry.QueryStamp = QueryStamp;
+
+				if (Overlaps(Entry.BoxTransform, Entry.BoxExtent, Location, Radius, HalfHeight))
+				{
+					OutHandles.Add(Handle);
+				}
+			}
+		}
+	}
+}
+
+bool FInteractionGrid::Overlaps(const FTransform& BoxTransform, const FVector& BoxExtent, const FVector& Location, float Radius, float HalfHeight)
+{
+	const FVector Local = BoxTransform.InverseTransformPositionNoScale(Location);
+
+	// Capsule bounds against the box, a bit generous on the corners
+	return (FMath::Abs(Local.X) <= BoxExtent.X + Radius)
+		&& (FMath::Abs(Local.Y) <= BoxExtent.Y + Radius)
+		&& (FMath::Abs(Local.Z) <= BoxExtent.Z + HalfHeight);
+}
+
+FIntPoint FInteractionGrid::GetCell(const FVector& Location) const
+{
+	return FIntPoint(FMath::FloorToInt(Location.X / CellSize), FMath::FloorToInt(Location.Y / CellSize));
+}
+
+void FInteractionGrid::AddToCells(int32 Handle)
+{
+	FEntry& Entry = Entries[Handle];
+
+	const FBox Bounds = FBox(-Entry.BoxExtent, Entry.BoxExtent).TransformBy(Entry.BoxTransform);
+	Entry.MinCell = GetCell(Bounds.Min);
+	Entry.MaxCell = GetCell(Bounds.Max);
+
+	for (int32 X = Entry.MinCell.X; X <= Entry.MaxCell.X; X++)
+	{
+		for (int32 Y = Entry.MinCell.Y; Y <= Entry.MaxCell.Y; Y++)
+		{
+			Cells.FindOrAdd(FIntPoint(X, Y)).Add(Handle);
+		}
+	}
+}
+
+void FInteractionGrid::RemoveFromCells(int32 Handle)
+{
+	const FEntry& Entry = Entries[Handle];
+
+	for (int32 X = Entry.MinCell.X; X <= Entry.MaxCell.X; X++)
+	{
+		for (int32 Y = Entry.MinCell.Y; Y <= Entry.MaxCell.Y; Y++)
+		{
+			const FIntPoint CellKey(X, Y);
+			TArray<int32>* Cell = Cells.Find(CellKey);
+
+			if (Cell == nullptr) continue;
+
+			Cell->RemoveSingleSwap(Handle);
+
+			if (Cell->Num() == 0)
+			{
+				Cells.Remove(CellKey);
+			}
+		}
+	}
+}
+
+
+//// UInteractionGridSubsystem ///////
+
+void UInteractionGridSubsystem::Deinitialize()
+{
+	Grid = FInteractionGrid();
+	Interactives.Empty();
+	PlayerOverlaps.Empty();
+
+	SET_DWORD_STAT(STAT_InteractionGridEntries, 0);
+
+	Super::Deinitialize();
+}
+
+void UInteractionGridSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	TimeSinceQuery += DeltaTime;
+
+	if (TimeSinceQuery < CVarInteractionQueryInterval.GetValueOnGameThread())
+	{
+		return;
+	}
+
+	TimeSinceQuery = 0.0f;
+
+	QueryPlayers();
+}
+
+TStatId UInteractionGridSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UInteractionGridSubsystem, STATGROUP_Tickables);
+}
+
+int32 UInteractionGridSubsystem::RegisterInteractive(ABasicInteractive* Interactive, const FTransform& BoxTransform, const FVector& BoxExtent)
+{
+	const int32 Handle = Grid.Add(BoxTransform, BoxExtent);
+
+	if (Interactives.Num() <= Handle)
+	{
+		Interactives.SetNum(Handle + 1);
+	}
+
+	Interactives[Handle] = Interactive;
+
+	SET_DWORD_STAT(STAT_InteractionGridEntries, Grid.Num());
+
+	return Handle;
+}
+
+void UInteractionGridSubsystem::UpdateInteractive(int32 Handle, const FTransform& BoxTransform, const FVector& BoxExtent)
+{
+	Grid.Update(Handle, BoxTransform, BoxExtent);
+}
+
+void UInteractionGridSubsystem::UnregisterInteractive(int32 Handle)
+{
+	if (!Interactives.IsValidIndex(Handle)) return;
+
+	ABasicInteractive* Interactive = Interactives[Handle].Get();
+	Interactives[Handle].Reset();
+
+	Grid.Remove(Handle);
+
+	SET_DWORD_STAT(STAT_InteractionGridEntries, Grid.Num());
+
+	TArray<ARPGPluginCharacter*, TInlineAllocator<4>> PlayersInside;
+
+	for (TPair<TWeakObjectPtr<ARPGPluginCharacter>, TSet<int32>>& Pair : PlayerOverlaps)
+	{
+		if ((Pair.Value.Remove(Handle) > 0) && Pair.Key.IsValid())
+		{
+			PlayersInside.Add(Pair.Key.Get());
+		}
+	}
+
+	if (Interactive != nullptr)
+	{
+		for (ARPGPluginCharacter* Player : PlayersInside)
+		{
+			Interactive->NotifyPlayerEndOverlap(Player);
+		}
+	}
+}
+
+void UInteractionGridSubsystem::QueryPlayers()
+{
+	SCOPE_CYCLE_COUNTER(STAT_InteractionGridQuery);
+
+	TArray<ARPGPluginCharacter*, TInlineAllocator<4>> Players;
+
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		APlayerController* PlayerController = It->Get();
+		ARPGPluginCharacter* Player = (PlayerController != nullptr) ? Cast<ARPGPluginCharacter>(PlayerController->GetPawn()) : nullptr;
+
+		if (Player != nullptr)
+		{
+			Players.Add(Player);
+			QueryPlayer(Player, PlayerOverlaps.FindOrAdd(Player));
+		}
+	}
+
+	// Players destroyed or unpossessed leave everything they were inside of
+	TArray<TPair<TWeakObjectPtr<ARPGPluginCharacter>, TSet<int32>>, TInlineAllocator<4>> Gone;
+
+	for (auto It = PlayerOverlaps.CreateIterator(); It; ++It)
+	{
+		if (!Players.Contains(It.Key().Get()))
+		{
+			Gone.Emplace(It.Key(), MoveTemp(It.Value()));
+			It.RemoveCurrent();
+		}
+	}
+
+	for (const TPair<TWeakObjectPtr<ARPGPluginCharacter>, TSet<int32>>& Pair : Gone)
+	{
+		ARPGPluginCharacter* Player = Pair.Key.Get();
+
+		if (Player == nullptr) continue;
+
+		for (int32 Handle : Pair.Value)
+		{
+			if (ABasicInteractive* Interactive = Interactives[Handle].Get())
+			{
+				Interactive->NotifyPlayerEndOverlap(Player);
+			}
+		}
+	}
+}
+
+void UInteractionGridSubsystem::QueryPlayer(ARPGPluginCharacter* Player, TSet<int32>& InOutInside)
+{
+	float Radius = 0.0f;
+	float HalfHeight = 0.0f;
+	Player->GetCapsuleComponent()->GetScaledCapsuleSize(Radius, HalfHeight);
+
+	Grid.Query(Player->GetActorLocation(), Radius, HalfHeight, QueryResults);
+
+	// Disabled collision stops the interaction, like it stopped the trigger overlaps
+	QueryResults.RemoveAllSwap([this](int32 Handle)
+	{
+		const ABasicInteractive* Interactive = Interactives[Handle].Get();
+		return (Interactive == nullptr) || !Interactive->GetActorEnableCollision();
+	});
+
+	TArray<TWeakObjectPtr<ABasicInteractive>, TInlineAllocator<8>> Left;
+	TArray<TWeakObjectPtr<ABasicInteractive>, TInlineAllocator<8>> Entered;
+
+	for (auto It = InOutInside.CreateIterator(); It; ++It)
+	{
+		if (!QueryResults.Contains(*It))
+		{
+			Left.Add(Interactives[*It]);
+			It.RemoveCurrent();
+		}
+	}
+
+	for (int32 Handle : QueryResults)
+	{
+		bool bAlreadyInside = false;
+		InOutInside.Add(Handle, &bAlreadyInside);
+
+		if (!bAlreadyInside)
+		{
+			Entered.Add(Interactives[Handle]);
+		}
+	}
+
+	// Called once the sets are up to date, they may register or unregister interactives.
+	// Leaving first, so moving from one interactive to the next ends on the new one
+	for (const TWeakObjectPtr<ABasicInteractive>& Interactive : Left)
+	{
+		if (Interactive.IsValid())
+		{
+			Interactive->NotifyPlayerEndOverlap(Player);
+		}
+	}
+
+	for (const TWeakObjectPtr<ABasicInteractive>& Interactive : Entered)
+	{
+		if (Interactive.IsValid())
+		{
+			Interactive->NotifyPlayerBeginOverlap(Player);
+		}
+	}
+}
+
+
+//// Benchmark ///////
+
+// rpg.Interaction.Benchmark [NumInteractives] [NumQueries]: grid queries against testing every trigger box
+static FAutoConsoleCommand InteractionBenchmarkCommand(
+	TEXT("rpg.Interaction.Benchmark"),
+	TEXT("Compares interaction grid queries with testing every interactive. Args: [NumInteractives=10000] [NumQueries=1000]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic([](const TArray<FString>& Args)
+	{
+		const int32 NumInteractives = (Args.Num() > 0) ? FCString::Atoi(*Args[0]) : 10000;
+		const int32 NumQueries = (Args.Num() > 1) ? FCString::Atoi(*Args[1]) : 1000;
+
+		if ((NumInteractives <= 0) || (NumQueries <= 0)) return;
+
+		// 2 x 2 km map, triggers of 1 to 3 m, default player capsule
+		const float MapSize = 200000.0f;
+		const float Radius = 42.0f;
+		const float HalfHeight = 96.0f;
+
+		FRandomStream Random(42);
+
+		TArray<FTransform> Transforms;
+		TArray<FVector> Extents;
+		Transforms.Reserve(NumInteractives);
+		Extents.Reserve(NumInteractives);
+
+		for (int i = 0; i < NumInteractives; i++)
+		{
+			const FVector Location(Random.FRandRange(0.0f, MapSize), Random.FRandRange(0.0f, MapSize), 0.0f);
+			Transforms.Add(FTransform(FRotator(0.0f, Random.FRandRange(0.0f, 360.0f), 0.0f), Location));
+			Extents.Add(FVector(Random.FRandRange(50.0f, 150.0f), Random.FRandRange(50.0f, 150.0f), 100.0f));
+		}
+
+		// Half of the players next to an interactive, half anywhere
+		TArray<FVector> Players;
+		Players.Reserve(NumQueries);
+
+		for (int i = 0; i < NumQueries; i++)
+		{
+			const FVector Location = ((i % 2) == 0)
+				? Transforms[Random.RandHelper(NumInteractives)].GetLocation() + FVector(Random.FRandRange(-100.0f, 100.0f), Random.FRandRange(-100.0f, 100.0f), 0.0f)
+				: FVector(Random.FRandRange(0.0f, MapSize), Random.FRandRange(0.0f, MapSize), 0.0f);
+
+			Players.Add(Location);
+		}
+
+		FInteractionGrid Grid;
+
+		double Start = FPlatformTime::Seconds();
+
+		for (int i = 0; i < NumInteractives; i++)
+		{
+			Grid.Add(Transforms[i], Extents[i]);
+		}
+
+		const double BuildTime = FPlatformTime::Seconds() - Start;
+
+		TArray<int32> Results;
+		int32 GridHits = 0;
+
+		Start = FPlatformTime::Seconds();
+
+		for (const FVector& Location : Players)
+		{
+			Grid.Query(Location, Radius, HalfHeight, Results);
+			GridHits += Results.Num();
+		}
+
+		const double GridTime = FPlatformTime::Seconds() - Start;
+
+		int32 AllHits = 0;
+
+		Start = FPlatformTime::Seconds();
+
+		for (const FVector& Location : Players)
+		{
+			for (int i = 0; i < NumInteractives; i++)
+			{
+				AllHits += FInteractionGrid::Overlaps(Transforms[i], Extents[i], Location, Radius, HalfHeight) ? 1 : 0;
+			}
+		}
+
+		const double AllTime = FPlatformTime::Seconds() - Start;
+
+		UE_LOG(LogTemp, Display, TEXT("[rpg.Interaction.Benchmark] %d interactives, %d queries"), NumInteractives, NumQueries);
+		UE_LOG(LogTemp, Display, TEXT("  Grid:      build %.3f ms, %.4f ms per query, %d overlaps"), BuildTime * 1000.0, GridTime * 1000.0 / NumQueries, GridHits);
+		UE_LOG(LogTemp, Display, TEXT("  Every box: %.4f ms per query, %d overlaps"), AllTime * 1000.0 / NumQueries, AllHits);
+	}));
@@ -0,0 +1,116 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "InteractionGridSubsystem.generated.h"
+
+class ABasicInteractive;
+class ARPGPluginCharacter;
+
+/**
+ * Uniform grid of oriented boxes on the XY plane. A box is added to every cell its bounds touch,
+ * so a query only looks at the cells around the point, whatever the size of the boxes.
+ */
+class RPGPLUGIN_API FInteractionGrid
+{
+public:
+
+	explicit FInteractionGrid(float InCellSize = 1000.0f);
+
+	// Scale of the transform is ignored, BoxExtent is the scaled extent
+	int32 Add(const FTransform& BoxTransform, const FVector& BoxExtent);
+
+	void Update(int32 Handle, const FTransform& BoxTransform, const FVector& BoxExtent);
+
+	void Remove(int32 Handle);
+
+	// Boxes overlapping an upright capsule, the capsule is approximated by its bounding box
+	void Query(const FVector& Location, float Radius, float HalfHeight, TArray<int32>& OutHandles);
+
+	int32 Num() const { return Entries.Num(); }
+
+	static bool Overlaps(const FTransform& BoxTransform, const FVector& BoxExtent, const FVector& Location, float Radius, float HalfHeight);
+
+private:
+
+	struct FEntry
+	{
+		FTransform BoxTransform;
+
+		FVector BoxExtent;
+
+		FIntPoint MinCell;
+
+		FIntPoint MaxCell;
+
+		// Boxes spanning several cells are tested once per query
+		uint32 QueryStamp = 0;
+	};
+
+	FIntPoint GetCell(const FVector& Location) const;
+
+	void AddToCells(int32 Handle);
+
+	void RemoveFromCells(int32 Handle);
+
+	float CellSize;
+
+	TSparseArray<FEntry> Entries;
+
+	TMap<FIntPoint, TArray<int32>> Cells;
+
+	uint32 QueryStamp = 0;
+};
+
+/**
+ * Player proximity for the interactives, without physics overlaps.
+ * Interactives register the box of their trigger instead of letting it generate overlap events. At a fixed rate
+ * (rpg.Interaction.QueryInterval) the grid is queried around each player, and the interactives the player entered
+ * or left get the same begin/end overlap calls the trigger used to send.
+ */
+UCLASS()
+class RPGPLUGIN_API UInteractionGridSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+
+	virtual void Deinitialize() override;
+
+	virtual void Tick(float DeltaTime) override;
+
+	virtual TStatId GetStatId() const override;
+
+	// Returns the handle for the calls below
+	int32 RegisterInteractive(ABasicInteractive* Interactive, const FTransform& BoxTransform, const FVector& BoxExtent);
+
+	// For interactives that move
+	void UpdateInteractive(int32 Handle, const FTransform& BoxTransform, const FVector& BoxExtent);
+
+	// Players inside get the end overlap, like when a trigger is destroyed
+	void UnregisterInteractive(int32 Handle);
+
+	// Runs the queries now instead of on the next interval
+	void QueryPlayers();
+
+	int32 GetNumInteractives() const { return Grid.Num(); }
+
+protected:
+
+	void QueryPlayer(ARPGPluginCharacter* Player, TSet<int32>& InOutInside);
+
+	FInteractionGrid Grid;
+
+	// Indexed by grid handle
+	TArray<TWeakObjectPtr<ABasicInteractive>> Interactives;
+
+	// Handles each player is inside of
+	TMap<TWeakObjectPtr<ARPGPluginCharacter>, TSet<int32>> PlayerOverlaps;
+
+	float TimeSinceQuery = 0.0f;
+
+	// Reused between queries
+	TArray<int32> QueryResults;
+};
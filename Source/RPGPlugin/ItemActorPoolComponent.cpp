@@ -0,0 +1,174 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ItemActorPoolComponent.h"
+#include "RPGPlugin.h"
+#include "AssetStreamingSubsystem.h"
+#include "GameFramework/Actor.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Item Pool Hits"), STAT_ItemPoolHits, STATGROUP_RPGPlugin);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Item Pool Misses"), STAT_ItemPoolMisses, STATGROUP_RPGPlugin);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Item Pool Free Actors"), STAT_ItemPoolFreeActors, STATGROUP_RPGPlugin);
+
+UItemActorPoolComponent::UItemActorPoolComponent()
+{
+	PrimaryComponentTick.bCanEverTick = false;
+}
+
+void UItemActorPoolComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	UAssetStreamingSubsystem* AssetStreaming = GetOwner()->GetGameInstance()->GetSubsystem<UAssetStreamingSubsystem>();
+
+	for (const TPair<TSoftClassPtr<AActor>, int32>& Prewarm : PrewarmCounts)
+	{
+		if ((Prewarm.Key.Get() != nullptr) || (AssetStreaming == nullptr))
+		{
+			PrewarmStreamedClass(Prewarm.Key, Prewarm.Value);
+		}
+		else
+		{
+			AssetStreaming->RequestAsset(Prewarm.Key.ToSoftObjectPath(), FStreamableDelegate::CreateUObject(this, &UItemActorPoolComponent::PrewarmStreamedClass, Prewarm.Key, Prewarm.Value));
+		}
+	}
+}
+
+void UItemActorPoolComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	for (TPair<UClass*, FItemActorPoolList>& Pool : FreeActors)
+	{
+		for (AActor* Actor : Pool.Value.Actors)
+		{
+			if (IsValid(Actor))
+			{
+				Actor->Destroy();
+			}
+		}
+
+		DEC_DWORD_STAT_BY(STAT_ItemPoolFreeActors, Pool.Value.Actors.Num());
+	}
+
+	FreeActors.Empty();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void UItemActorPoolComponent::PrewarmStreamedClass(TSoftClassPtr<AActor> ActorClass, int32 Count)
+{
+	Prewarm(ActorClass.LoadSynchronous(), Count);
+}
+
+void UItemActorPoolComponent::Prewarm(UClass* ActorClass, int32 Count)
+{
+	if ((ActorClass == nullptr) || (Count <= 0)) return;
+
+	FItemActorPoolList& Pool = FreeActors.FindOrAdd(ActorClass);
+	Pool.Actors.Reserve(Pool.Actors.Num() + Count);
+
+	for (int i = 0; i < Count; i++)
+	{
+		AActor* Actor = SpawnPooledActor(ActorClass);
+
+		if (Actor != nullptr)
+		{
+			ResetPooledActor(Actor);
+			Pool.Actors.Add(Actor);
+			INC_DWORD_STAT(STAT_ItemPoolFreeActors);
+		}
+	}
+}
+
+AActor* UItemActorPoolComponent::Acquire(UClass* ActorClass)
+{
+	if (ActorClass == nullptr) return nullptr;
+
+	if (FItemActorPoolList* Pool = FreeActors.Find(ActorClass))
+	{
+		while (Pool->Actors.Num() > 0)
+		{
+			AActor* Actor = Pool->Actors.Pop(false);
+			DEC_DWORD_STAT(STAT_ItemPoolFreeActors);
+
+			// Pooled actors can be destroyed by level code, skip them
+			if (!IsValid(Actor)) continue;
+
+			if (!bAttachFreeActors)
+			{
+				AttachPooledActor(Actor);
+			}
+
+			// Back to the defaults of its class
+			const AActor* DefaultActor = Actor->GetClass()->GetDefaultObject<AActor>();
+			Actor->SetActorEnableCollision(DefaultActor->GetActorEnableCollision());
+			Actor->SetActorTickEnabled(DefaultActor->PrimaryActorTick.bStartWithTickEnabled);
+
+			PoolHits++;
+			INC_DWORD_STAT(STAT_ItemPoolHits);
+			return Actor;
+		}
+	}
+
+	PoolMisses++;
+	INC_DWORD_STAT(STAT_ItemPoolMisses);
+
+	AActor* Actor = SpawnPooledActor(ActorClass);
+	if (Actor != nullptr)
+	{
+		Actor->SetActorHiddenInGame(true);
+	}
+	return Actor;
+}
+
+void UItemActorPoolComponent::Release(AActor* Actor)
+{
+	if (!IsValid(Actor)) return;
+
+	ResetPooledActor(Actor);
+
+	FreeActors.FindOrAdd(Actor->GetClass()).Actors.Add(Actor);
+	INC_DWORD_STAT(STAT_ItemPoolFreeActors);
+}
+
+int32 UItemActorPoolComponent::GetNumFree(UClass* ActorClass) const
+{
+	const FItemActorPoolList* Pool = FreeActors.Find(ActorClass);
+	return (Pool != nullptr) ? Pool->Actors.Num() : 0;
+}
+
+AActor* UItemActorPoolComponent::SpawnPooledActor(UClass* ActorClass)
+{
+	AActor* Actor = GetWorld()->SpawnActor<AActor>(ActorClass, FVector::ZeroVector, FRotator::ZeroRotator);
+
+	if (Actor != nullptr)
+	{
+		AttachPooledActor(Actor);
+	}
+
+	return Actor;
+}
+
+void UItemActorPoolComponent::AttachPooledActor(AActor* Actor)
+{
+	USceneComponent* Parent = (AttachPoint != nullptr) ? AttachPoint : GetOwner()->GetRootComponent();
+	Actor->AttachToComponent(Parent, FAttachmentTransformRules::SnapToTargetNotIncludingScale);
+}
+
+void UItemActorPoolComponent::ResetPooledActor(AActor* Actor)
+{
+	Actor->SetActorHiddenInGame(true);
+	Actor->SetActorEnableCollision(false);
+	Actor->SetActorTickEnabled(false);
+
+	if (bAttachFreeActors)
+	{
+		// Game code may have moved it while it was on hands
+		Actor->SetActorRelativeLocation(FVector::ZeroVector);
+		Actor->SetActorRelativeRotation(FRotator::ZeroRotator);
+	}
+	else
+	{
+		// Parked where it is, no transform updates until it is acquired again
+		Actor->DetachFromActor(FDetachmentTransformRules::KeepWorldTransform);
+	}
+}
@@ -0,0 +1,83 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "ItemActorPoolComponent.generated.h"
+
+USTRUCT()
+struct FItemActorPoolList
+{
+	GENERATED_USTRUCT_BODY()
+
+		UPROPERTY()
+		TArray<AActor*> Actors;
+};
+
+/**
+ * Recycles the actors held on hands, keyed by class.
+ * Returned actors stay hidden and attached to the attach point, ready to be handed out again,
+ * so steady inventory churn does not spawn nor destroy actors.
+ */
+UCLASS(ClassGroup = (RPG), meta = (BlueprintSpawnableComponent))
+class RPGPLUGIN_API UItemActorPoolComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+
+	UItemActorPoolComponent();
+
+	// Component pooled actors are attached to, the owner root if not set
+	void SetAttachPoint(USceneComponent* InAttachPoint) { AttachPoint = InAttachPoint; }
+
+	// When false, free actors are detached and parked so they don't follow the attach point transform
+	void SetAttachFreeActors(bool bAttach) { bAttachFreeActors = bAttach; }
+
+	// Returns an attached, hidden actor of the class. Spawns one if the pool is empty
+	AActor* Acquire(UClass* ActorClass);
+
+	// Hides the actor, resets its state and keeps it for the next Acquire
+	void Release(AActor* Actor);
+
+	// Spawns Count hidden actors of the class ahead of time
+	void Prewarm(UClass* ActorClass, int32 Count);
+
+	int32 GetNumFree(UClass* ActorClass) const;
+
+protected:
+
+	virtual void BeginPlay() override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	AActor* SpawnPooledActor(UClass* ActorClass);
+
+	void AttachPooledActor(AActor* Actor);
+
+	void ResetPooledActor(AActor* Actor);
+
+	void PrewarmStreamedClass(TSoftClassPtr<AActor> ActorClass, int32 Count);
+
+	// Classes and number of actors spawned when the game starts
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Pool")
+		TMap<TSoftClassPtr<AActor>, int32> PrewarmCounts;
+
+	// Acquires served from the pool
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Pool")
+		int32 PoolHits = 0;
+
+	// Acquires that had to spawn a new actor
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Pool")
+		int32 PoolMisses = 0;
+
+	UPROPERTY(Transient)
+		TMap<UClass*, FItemActorPoolList> FreeActors;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Pool")
+		bool bAttachFreeActors = true;
+
+	UPROPERTY(Transient)
+		USceneComponent* AttachPoint;
+};
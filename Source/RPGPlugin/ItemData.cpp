@@ -3,6 +3,106 @@
 
 #include "ItemData.h"
 
+//// Quests ///////
+
+void UQuestData::BuildIndex()
+{
+	QuestIDToIndex.Empty(QuestData.Num());
+
+	for (int i = 0; i < QuestData.Num(); i++)
+	{
+		if (!QuestIDToIndex.Contains(QuestData[i].QuestID))
+		{
+			QuestIDToIndex.Add(QuestData[i].QuestID, i);
+		}
+	}
+}
+
+int32 UQuestData::FindQuestIndex(FName QuestID) const
+{
+	const int32* Index = QuestIDToIndex.Find(QuestID);
+	return (Index != nullptr) ? *Index : INDEX_NONE;
+}
+
+const FQuest* UQuestData::FindQuest(FName QuestID) const
+{
+	return GetQuestByIndex(FindQuestIndex(QuestID));
+}
+
+const FQuest* UQuestData::GetQuestByIndex(int32 Index) const
+{
+	return QuestData.IsValidIndex(Index) ? &QuestData[Index] : nullptr;
+}
+
+void UQuestData::PostLoad()
+{
+	Super::PostLoad();
+
+	BuildIndex();
+}
+
+#if WITH_EDITOR
+void UQuestData::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+
+	BuildIndex();
+}
+#endif
+
+//// Quests ///////
+
+
+//// Items ///////
+
+void UItemData::BuildIndex()
+{
+	ItemIDToIndex.Empty(Data.Num());
+
+	for (int i = 0; i < Data.Num(); i++)
+	{
+		if (!ItemIDToIndex.Contains(Data[i].ItemID))
+		{
+			ItemIDToIndex.Add(Data[i].ItemID, i);
+		}
+	}
+}
+
+int32 UItemData::FindItemIndex(FName ItemID) const
+{
+	const int32* Index = ItemIDToIndex.Find(ItemID);
+	return (Index != nullptr) ? *Index : INDEX_NONE;
+}
+
+const FItem* UItemData::FindItem(FName ItemID) const
+{
+	return GetItemByIndex(FindItemIndex(ItemID));
+}
+
+const FItem* UItemData::GetItemByIndex(int32 Index) const
+{
+	return Data.IsValidIndex(Index) ? &Data[Index] : nullptr;
+}
+
+void UItemData::PostLoad()
+{
+	Super::PostLoad();
+
+	BuildIndex();
+}
+
+#if WITH_EDITOR
+void UItemData::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+
+	BuildIndex();
+}
+#endif
+
+//// Items ///////
+
+
 ItemData::ItemData()
 {
 
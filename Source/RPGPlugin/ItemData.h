@@ -6,6 +6,37 @@
 #include "Engine/DataAsset.h"
 #include "ItemData.generated.h"
 
+UENUM(BlueprintType)
+enum class EQuestObjectiveType : uint8
+{
+	E_CollectItem		UMETA(DisplayName = "COLLECT ITEM"),
+	E_KillEnemy			UMETA(DisplayName = "KILL ENEMY"),
+	E_ReachCheckpoint	UMETA(DisplayName = "REACH CHECKPOINT")
+};
+
+USTRUCT(BlueprintType)
+struct FQuestObjective
+{
+	GENERATED_USTRUCT_BODY()
+
+		UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Quest")
+		EQuestObjectiveType Type = EQuestObjectiveType::E_CollectItem;
+
+	// ItemID to collect or name of the checkpoint to reach
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Quest")
+		FName TargetID;
+
+	// Enemies of this class, or a child class, count for E_KillEnemy
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Quest")
+		TSubclassOf<class AActor> EnemyClass;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Quest")
+		int32 RequiredCount = 1;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Quest")
+		FText Description;
+};
+
 USTRUCT(BlueprintType)
 struct FQuest
 {
@@ -29,8 +60,17 @@ struct FQuest
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Quest")
 		FName ItemID;
 
+	// Streamed when the quest popup is shown
 	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Quest")
-		UTexture2D* ItemQuestTexture;
+		TSoftObjectPtr<UTexture2D> ItemQuestTexture;
+
+	// Quests completing on their own when every objective is done. If ItemID is set the item is still delivered on the chest
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Quest")
+		TArray<FQuestObjective> Objectives;
+
+	// Quests that must be completed before this one can be accepted
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Quest")
+		TArray<FName> Prerequisites;
 
 };
 
@@ -44,6 +84,29 @@ public:
 
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Quest")
 		TArray<FQuest> QuestData;
+
+public:
+
+	// Builds the QuestID -> array index lookup, first entry wins on duplicated IDs
+	void BuildIndex();
+
+	// Index of the quest in QuestData, INDEX_NONE if not found
+	int32 FindQuestIndex(FName QuestID) const;
+
+	// Quest stored on the asset, nullptr if not found. Valid until the asset changes
+	const FQuest* FindQuest(FName QuestID) const;
+
+	const FQuest* GetQuestByIndex(int32 Index) const;
+
+	virtual void PostLoad() override;
+
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
+
+protected:
+
+	TMap<FName, int32> QuestIDToIndex;
 };
 
 USTRUCT(BlueprintType)
@@ -56,6 +119,13 @@ struct FQuestItem
 
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Quest")
 		bool IsCompleted;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Quest")
+		int32 Progress = 0;
+
+	// Count per FQuest::Objectives entry
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Quest")
+		TArray<int32> ObjectiveProgress;
 };
 
 
@@ -75,18 +145,78 @@ struct FItem
 		FText Description;
 
 	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Item")
-		TSubclassOf<class AActor> ItemActor; // Item to hold on hands
+		TSoftClassPtr<class AActor> ItemActor; // Item to hold on hands, streamed when the item is added
 
 	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Item")
-		UTexture2D* ItemIcon; // Texture 2D to show on the UI
+		TSoftObjectPtr<UTexture2D> ItemIcon; // Texture 2D to show on the UI, streamed on demand
+};
+
+// Index of an item definition on UItemData
+USTRUCT(BlueprintType)
+struct FItemHandle
+{
+	GENERATED_USTRUCT_BODY()
 
+		UPROPERTY(BlueprintReadOnly, Category = "Item")
+		int32 Index = INDEX_NONE;
+
+	FItemHandle() {}
+
+	explicit FItemHandle(int32 InIndex) : Index(InIndex) {}
+
+	bool IsValid() const { return Index != INDEX_NONE; }
+
+	bool operator==(const FItemHandle& Other) const { return Index == Other.Index; }
+
+	bool operator!=(const FItemHandle& Other) const { return Index != Other.Index; }
+};
+
+// Player inventory element, the shared item information stays on the definition
+USTRUCT(BlueprintType)
+struct FInventoryItem
+{
+	GENERATED_USTRUCT_BODY()
+
+		UPROPERTY(BlueprintReadOnly, Category = "Player Inventory")
+		FItemHandle Definition;
 
-		// Player inventory elements
 	UPROPERTY(BlueprintReadOnly, Category = "Player Inventory")
-		AActor* SpawnedItem; // Spawned item on player
+		int32 Quantity = 0; // Number of items in inventory
 
 	UPROPERTY(BlueprintReadOnly, Category = "Player Inventory")
-		int32 Quantity; // Number of items in inventory
+		AActor* SpawnedItem = nullptr; // Spawned item on player
+
+	UPROPERTY(BlueprintReadWrite, Category = "Player Inventory")
+		int32 InstanceData = 0; // Free for game code, e.g. durability or charges
+};
+
+// Quantity of an item, used by the bulk inventory operations
+USTRUCT(BlueprintType)
+struct FItemStack
+{
+	GENERATED_USTRUCT_BODY()
+
+		UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Item")
+		FName ItemID;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Item")
+		int32 Quantity = 1;
+};
+
+// Inventory element on the save, by ID so it survives changes on the item data asset
+USTRUCT(BlueprintType)
+struct FInventorySaveItem
+{
+	GENERATED_USTRUCT_BODY()
+
+		UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Player Inventory")
+		FName ItemID;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Player Inventory")
+		int32 Quantity = 0;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Player Inventory")
+		int32 InstanceData = 0;
 };
 
 
@@ -99,6 +229,33 @@ public:
 
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Item Data")
 		TArray<FItem> Data;
+
+public:
+
+	// Builds the ItemID -> array index lookup, first entry wins on duplicated IDs
+	void BuildIndex();
+
+	// Index of the item in Data, INDEX_NONE if not found
+	int32 FindItemIndex(FName ItemID) const;
+
+	// Item stored on the asset, nullptr if not found. Valid until the asset changes
+	const FItem* FindItem(FName ItemID) const;
+
+	const FItem* GetItemByIndex(int32 Index) const;
+
+	FItemHandle FindItemHandle(FName ItemID) const { return FItemHandle(FindItemIndex(ItemID)); }
+
+	const FItem* GetItem(FItemHandle Handle) const { return GetItemByIndex(Handle.Index); }
+
+	virtual void PostLoad() override;
+
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
+
+protected:
+
+	TMap<FName, int32> ItemIDToIndex;
 };
 
 
@@ -3,13 +3,24 @@
 
 #include "ItemInteractive.h"
 #include "RPGPluginCharacter.h"
+#include "RPGPluginGameMode.h"
+#include "AssetStreamingSubsystem.h"
 
 
 void AItemInteractive::BeginPlay()
 {
+	bItemCollected = false;
+
+	// Restores bItemCollected from the save
 	Super::BeginPlay();
+}
 
-	bItemCollected = false;
+void AItemInteractive::ApplyPersistentFlag(bool bFlag)
+{
+	bItemCollected = bFlag;
+
+	SetActorHiddenInGame(bFlag);
+	SetActorEnableCollision(!bFlag);
 }
 
 
@@ -17,13 +28,14 @@ void AItemInteractive::OnInteract_Implementation()
 {
 	if (bItemCollected) return;
 
-	if (PlayerCharacter != nullptr)
+	if (ARPGPluginCharacter* Player = PlayerCharacter.Get())
 	{
-		if (PlayerCharacter->HasFreeInventorySlots())
+		if (Player->HasFreeInventorySlots())
 		{
-			PlayerCharacter->AddItem(ItemID);
+			Player->AddItem(ItemID);
 
 			bItemCollected = true;
+			SetPersistentFlag(true);
 
 			OnItemCollected();
 		}
@@ -42,21 +54,38 @@ FName AItemInteractive::GetQuestID()
 
 
 
-void AItemInteractive::OnPlayerBeginOverlap()
+void AItemInteractive::PrefetchItemAssets()
 {
-	if (PlayerCharacter != nullptr)
+	if (bItemCollected) return;
+
+	ARPGPluginGameMode* GameMode = Cast<ARPGPluginGameMode>(GetWorld()->GetAuthGameMode());
+	const FItem* ItemData = (GameMode != nullptr) ? GameMode->FindItemData(ItemID) : nullptr;
+
+	UAssetStreamingSubsystem* AssetStreaming = GetGameInstance()->GetSubsystem<UAssetStreamingSubsystem>();
+
+	if ((ItemData != nullptr) && (AssetStreaming != nullptr))
 	{
-		PlayerCharacter->OnShowUI(InteractiveName);
+		AssetStreaming->PrefetchItem(*ItemData);
 	}
 }
 
 
-void AItemInteractive::OnPlayerEndOverlap()
+void AItemInteractive::OnPlayerBeginOverlap(ARPGPluginCharacter* Player)
 {
-	if (PlayerCharacter != nullptr)
-	{
-		PlayerCharacter->OnHideUI();
-	}
+	// The player will likely pick it up, have the assets ready
+	PrefetchItemAssets();
+}
+
+
+void AItemInteractive::OnPlayerFocusBegin(ARPGPluginCharacter* Player)
+{
+	Player->OnShowUI(InteractiveName);
+}
+
+
+void AItemInteractive::OnPlayerFocusEnd(ARPGPluginCharacter* Player)
+{
+	Player->OnHideUI();
 }
 
 
@@ -28,17 +28,28 @@ protected:
 	UFUNCTION(BlueprintImplementableEvent, BlueprintCallable, Category = "Events")
 		void OnItemCollected();
 
+public:
+
+	// Starts streaming the icon and actor of the item, called when a player gets close
+	UFUNCTION(BlueprintCallable, Category = "Item")
+		void PrefetchItemAssets();
+
 protected:
 
 	virtual void BeginPlay() override;
 
+	// Collected items stay collected after a reload
+	void ApplyPersistentFlag(bool bFlag) override;
+
 
 	//////////// ABasicInteractive override methods //////////////////
 protected:
 
-	void OnPlayerBeginOverlap() override;
+	void OnPlayerBeginOverlap(ARPGPluginCharacter* Player) override;
+
+	void OnPlayerFocusBegin(ARPGPluginCharacter* Player) override;
 
-	void OnPlayerEndOverlap() override;
+	void OnPlayerFocusEnd(ARPGPluginCharacter* Player) override;
 
 	//////////// ABasicInteractive override methods //////////////////
 
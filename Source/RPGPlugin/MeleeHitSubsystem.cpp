@@ -0,0 +1,122 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "MeleeHitSubsystem.h"
+#include "RPGPlugin.h"
+#include "Engine/World.h"
+
+DECLARE_CYCLE_STAT(TEXT("Melee Hits"), STAT_MeleeHits, STATGROUP_RPGPlugin);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Melee Swings Traced"), STAT_MeleeSwings, STATGROUP_RPGPlugin);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Melee Hits Delivered"), STAT_MeleeHitsDelivered, STATGROUP_RPGPlugin);
+
+
+void UMeleeHitSubsystem::Deinitialize()
+{
+	Pending.Empty();
+	InFlight.Empty();
+
+	Super::Deinitialize();
+}
+
+TStatId UMeleeHitSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UMeleeHitSubsystem, STATGROUP_Tickables);
+}
+
+void UMeleeHitSubsystem::QueueSwing(AActor* Attacker, const FVector& Start, const FVector& End, float Radius, float Damage, EDamageKind Kind)
+{
+	if ((Attacker == nullptr) || (Radius <= 0.0f) || (Damage <= 0.0f)) return;
+
+	FMeleeSwing& Swing = Pending.AddDefaulted_GetRef();
+	Swing.Attacker = Attacker;
+	Swing.Start = Start;
+	Swing.End = End;
+	Swing.Radius = Radius;
+	Swing.Damage = Damage;
+	Swing.Kind = Kind;
+}
+
+void UMeleeHitSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	SCOPE_CYCLE_COUNTER(STAT_MeleeHits);
+
+	// Swings traced on the previous frames
+	UDamageQueueSubsystem* DamageQueue = GetWorld()->GetSubsystem<UDamageQueueSubsystem>();
+
+	InFlight.RemoveAll([this, DamageQueue](const FMeleeSwing& Swing)
+	{
+		return DeliverHits(Swing, DamageQueue);
+	});
+
+	// Swings of this frame, the results are read on the next ones
+	IssueSwings();
+}
+
+void UMeleeHitSubsystem::IssueSwings()
+{
+	SET_DWORD_STAT(STAT_MeleeSwings, Pending.Num());
+
+	if (Pending.Num() == 0) return;
+
+	UWorld* World = GetWorld();
+
+	// Every actor that can take damage is dynamic, the static level geometry is not queried
+	const FCollisionObjectQueryParams ObjectParams(FCollisionObjectQueryParams::InitType::AllDynamicObjects);
+
+	for (FMeleeSwing& Swing : Pending)
+	{
+		AActor* Attacker = Swing.Attacker.Get();
+		if (Attacker == nullptr) continue;
+
+		FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(MeleeSwing), false, Attacker);
+
+		// Nor what it carries: the held weapon and the item actors on the hands
+		Attacker->GetAttachedActors(AttachedScratch, true, true);
+		QueryParams.AddIgnoredActors(AttachedScratch);
+
+		Swing.TraceHandle = World->AsyncSweepByObjectType(EAsyncTraceType::Multi, Swing.Start, Swing.End, FQuat::Identity,
+			ObjectParams, FCollisionShape::MakeSphere(Swing.Radius), QueryParams);
+
+		InFlight.Add(Swing);
+	}
+
+	Pending.Reset();
+}
+
+bool UMeleeHitSubsystem::DeliverHits(const FMeleeSwing& Swing, UDamageQueueSubsystem* DamageQueue)
+{
+	if (!GetWorld()->QueryTraceData(Swing.TraceHandle, TraceData))
+	{
+		// Not run yet, unless the world doesn't hold the results anymore
+		return !GetWorld()->IsTraceHandleValid(Swing.TraceHandle, false);
+	}
+
+	AActor* Attacker = Swing.Attacker.Get();
+
+	// A dead attacker doesn't land its swing
+	if ((Attacker == nullptr) || (DamageQueue == nullptr)) return true;
+
+	// A swing may touch several components of the same actor
+	TArray<AActor*, TInlineAllocator<8>> HitActors;
+
+	for (const FHitResult& Hit : TraceData.OutHits)
+	{
+		AActor* HitActor = Hit.GetActor();
+
+		if ((HitActor != nullptr) && (HitActor != Attacker))
+		{
+			HitActors.AddUnique(HitActor);
+		}
+	}
+
+	for (AActor* HitActor : HitActors)
+	{
+		DamageQueue->QueueDamage(Attacker, HitActor, Swing.Damage, Swing.Kind);
+	}
+
+	INC_DWORD_STAT_BY(STAT_MeleeHitsDelivered, HitActors.Num());
+
+	return true;
+}
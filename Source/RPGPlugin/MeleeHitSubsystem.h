@@ -0,0 +1,70 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "WorldCollision.h"
+#include "DamageQueueSubsystem.h"
+#include "MeleeHitSubsystem.generated.h"
+
+/**
+ * Hit detection for the melee attacks of every fighter, without a sweep per attack on the game thread.
+ * Swings queued during a frame are issued together at the end of it as async sphere sweeps, which the physics
+ * scene runs in parallel with the next frame. Their results are read on the next tick and every actor a swing
+ * touched gets one hit queued on the UDamageQueueSubsystem.
+ */
+UCLASS()
+class RPGPLUGIN_API UMeleeHitSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+
+	virtual void Deinitialize() override;
+
+	virtual void Tick(float DeltaTime) override;
+
+	virtual TStatId GetStatId() const override;
+
+	// Sphere swept from Start to End. Each actor it touches is hit once, the attacker and the actors attached to it never
+	UFUNCTION(BlueprintCallable, Category = "Damage")
+		void QueueSwing(AActor* Attacker, const FVector& Start, const FVector& End, float Radius, float Damage, EDamageKind Kind = EDamageKind::E_Default);
+
+	int32 GetNumSwingsInFlight() const { return InFlight.Num(); }
+
+protected:
+
+	struct FMeleeSwing
+	{
+		TWeakObjectPtr<AActor> Attacker;
+
+		FVector Start;
+
+		FVector End;
+
+		float Radius;
+
+		float Damage;
+
+		EDamageKind Kind;
+
+		FTraceHandle TraceHandle;
+	};
+
+	void IssueSwings();
+
+	// Returns false while the results are not ready yet
+	bool DeliverHits(const FMeleeSwing& Swing, UDamageQueueSubsystem* DamageQueue);
+
+	// Queued this frame
+	TArray<FMeleeSwing> Pending;
+
+	// Traced, waiting for the results
+	TArray<FMeleeSwing> InFlight;
+
+	// Reused between frames
+	FTraceDatum TraceData;
+
+	TArray<AActor*> AttachedScratch;
+};
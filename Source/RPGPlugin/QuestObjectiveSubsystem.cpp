@@ -0,0 +1,148 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "QuestObjectiveSubsystem.h"
+#include "RPGPluginCharacter.h"
+
+void UQuestObjectiveSubsystem::Deinitialize()
+{
+	Subscriptions.Empty();
+	CharacterKeys.Empty();
+
+	Super::Deinitialize();
+}
+
+FQuestEventKey UQuestObjectiveSubsystem::MakeEventKey(const FQuestObjective& Objective)
+{
+	if ((Objective.Type == EQuestObjectiveType::E_KillEnemy) && (Objective.EnemyClass != nullptr))
+	{
+		return FQuestEventKey(Objective.Type, Objective.EnemyClass->GetFName());
+	}
+
+	return FQuestEventKey(Objective.Type, Objective.TargetID);
+}
+
+void UQuestObjectiveSubsystem::SubscribeQuest(ARPGPluginCharacter* Character, int32 QuestIndex, const FQuest& Quest)
+{
+	if (Character == nullptr) return;
+
+	for (int i = 0; i < Quest.Objectives.Num(); i++)
+	{
+		if (Character->IsQuestObjectiveDone(QuestIndex, i)) continue;
+
+		const FQuestEventKey EventKey = MakeEventKey(Quest.Objectives[i]);
+
+		Subscriptions.FindOrAdd(EventKey).Add({ Character, QuestIndex, i });
+		CharacterKeys.FindOrAdd(Character).Add(EventKey);
+	}
+}
+
+void UQuestObjectiveSubsystem::UnsubscribeQuest(ARPGPluginCharacter* Character, int32 QuestIndex, const FQuest& Quest)
+{
+	for (const FQuestObjective& Objective : Quest.Objectives)
+	{
+		const FQuestEventKey EventKey = MakeEventKey(Objective);
+
+		TArray<FObjectiveSubscription>* Subscribers = Subscriptions.Find(EventKey);
+		if (Subscribers == nullptr) continue;
+
+		Subscribers->RemoveAllSwap([Character, QuestIndex](const FObjectiveSubscription& Subscription)
+		{
+			return (Subscription.QuestIndex == QuestIndex) && (Subscription.Character == Character);
+		});
+
+		if (Subscribers->Num() == 0)
+		{
+			Subscriptions.Remove(EventKey);
+		}
+	}
+}
+
+void UQuestObjectiveSubsystem::UnsubscribeCharacter(ARPGPluginCharacter* Character)
+{
+	TSet<FQuestEventKey> Keys;
+	if (!CharacterKeys.RemoveAndCopyValue(Character, Keys)) return;
+
+	for (const FQuestEventKey& EventKey : Keys)
+	{
+		TArray<FObjectiveSubscription>* Subscribers = Subscriptions.Find(EventKey);
+		if (Subscribers == nullptr) continue;
+
+		Subscribers->RemoveAllSwap([Character](const FObjectiveSubscription& Subscription)
+		{
+			return Subscription.Character == Character;
+		});
+
+		if (Subscribers->Num() == 0)
+		{
+			Subscriptions.Remove(EventKey);
+		}
+	}
+}
+
+void UQuestObjectiveSubsystem::NotifyItemCollected(ARPGPluginCharacter* Character, FName ItemID, int32 Count)
+{
+	DispatchEvent(FQuestEventKey(EQuestObjectiveType::E_CollectItem, ItemID), Character, Count);
+}
+
+void UQuestObjectiveSubsystem::NotifyEnemyKilled(AActor* Enemy, ARPGPluginCharacter* Killer)
+{
+	if (Enemy == nullptr) return;
+
+	NotifyEnemyKilled(Enemy->GetClass(), Killer);
+}
+
+void UQuestObjectiveSubsystem::NotifyEnemyKilled(UClass* EnemyClass, ARPGPluginCharacter* Killer)
+{
+	// Objectives may target a parent class of the enemy, walk up the hierarchy
+	for (UClass* Class = EnemyClass; (Class != nullptr) && (Class != AActor::StaticClass()); Class = Class->GetSuperClass())
+	{
+		DispatchEvent(FQuestEventKey(EQuestObjectiveType::E_KillEnemy, Class->GetFName()), Killer, 1);
+	}
+}
+
+void UQuestObjectiveSubsystem::NotifyCheckpointReached(ARPGPluginCharacter* Character, FName CheckpointName)
+{
+	DispatchEvent(FQuestEventKey(EQuestObjectiveType::E_ReachCheckpoint, CheckpointName), Character, 1);
+}
+
+void UQuestObjectiveSubsystem::DispatchEvent(const FQuestEventKey& EventKey, ARPGPluginCharacter* Character, int32 Count)
+{
+	TArray<FObjectiveSubscription>* Subscribers = Subscriptions.Find(EventKey);
+	if (Subscribers == nullptr) return;
+
+	// Advancing an objective can complete a quest and change the subscriptions, work on a copy
+	TArray<FObjectiveSubscription, TInlineAllocator<8>> Matches;
+	for (const FObjectiveSubscription& Subscription : *Subscribers)
+	{
+		if ((Character == nullptr) || (Subscription.Character == Character))
+		{
+			Matches.Add(Subscription);
+		}
+	}
+
+	for (const FObjectiveSubscription& Match : Matches)
+	{
+		ARPGPluginCharacter* Subscriber = Match.Character.Get();
+
+		const bool bObjectiveDone = (Subscriber == nullptr) || Subscriber->AdvanceQuestObjective(Match.QuestIndex, Match.ObjectiveIndex, Count);
+
+		if (bObjectiveDone)
+		{
+			// The array may have been reallocated by a quest completion
+			Subscribers = Subscriptions.Find(EventKey);
+			if (Subscribers == nullptr) return;
+
+			Subscribers->RemoveAllSwap([&Match](const FObjectiveSubscription& Subscription)
+			{
+				return (Subscription.Character == Match.Character) && (Subscription.QuestIndex == Match.QuestIndex) && (Subscription.ObjectiveIndex == Match.ObjectiveIndex);
+			});
+		}
+	}
+
+	Subscribers = Subscriptions.Find(EventKey);
+	if ((Subscribers != nullptr) && (Subscribers->Num() == 0))
+	{
+		Subscriptions.Remove(EventKey);
+	}
+}
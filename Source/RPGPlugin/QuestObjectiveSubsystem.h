@@ -0,0 +1,81 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ItemData.h"
+#include "QuestObjectiveSubsystem.generated.h"
+
+class ARPGPluginCharacter;
+
+// Game event an objective listens to: an ItemID, an enemy class name or a checkpoint name
+struct FQuestEventKey
+{
+	EQuestObjectiveType Type;
+
+	FName Key;
+
+	FQuestEventKey(EQuestObjectiveType InType, FName InKey) : Type(InType), Key(InKey) {}
+
+	bool operator==(const FQuestEventKey& Other) const { return (Type == Other.Type) && (Key == Other.Key); }
+
+	friend uint32 GetTypeHash(const FQuestEventKey& EventKey)
+	{
+		return HashCombine(::GetTypeHash(static_cast<uint8>(EventKey.Type)), GetTypeHash(EventKey.Key));
+	}
+};
+
+/**
+ * Evaluates quest objectives only when a relevant event fires.
+ * Keeps a reverse index from event key to the objectives of the active quests waiting on it,
+ * so an item pickup or an enemy death only touches the objectives that care about it.
+ */
+UCLASS()
+class RPGPLUGIN_API UQuestObjectiveSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+
+	virtual void Deinitialize() override;
+
+	// Subscribes the objectives of the quest that are not done yet
+	void SubscribeQuest(ARPGPluginCharacter* Character, int32 QuestIndex, const FQuest& Quest);
+
+	void UnsubscribeQuest(ARPGPluginCharacter* Character, int32 QuestIndex, const FQuest& Quest);
+
+	void UnsubscribeCharacter(ARPGPluginCharacter* Character);
+
+	//// Events ///////
+
+	void NotifyItemCollected(ARPGPluginCharacter* Character, FName ItemID, int32 Count = 1);
+
+	// Without a killer every character waiting on this enemy gets the credit
+	void NotifyEnemyKilled(AActor* Enemy, ARPGPluginCharacter* Killer);
+
+	// For enemies simulated without an actor, see UEnemyCrowdSubsystem
+	void NotifyEnemyKilled(UClass* EnemyClass, ARPGPluginCharacter* Killer);
+
+	void NotifyCheckpointReached(ARPGPluginCharacter* Character, FName CheckpointName);
+
+	static FQuestEventKey MakeEventKey(const FQuestObjective& Objective);
+
+protected:
+
+	struct FObjectiveSubscription
+	{
+		TWeakObjectPtr<ARPGPluginCharacter> Character;
+
+		int32 QuestIndex;
+
+		int32 ObjectiveIndex;
+	};
+
+	void DispatchEvent(const FQuestEventKey& EventKey, ARPGPluginCharacter* Character, int32 Count);
+
+	TMap<FQuestEventKey, TArray<FObjectiveSubscription>> Subscriptions;
+
+	// Keys each character is subscribed to, to clean up without walking the whole index
+	TMap<TWeakObjectPtr<ARPGPluginCharacter>, TSet<FQuestEventKey>> CharacterKeys;
+};
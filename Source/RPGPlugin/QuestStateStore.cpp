@@ -0,0 +1,259 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "QuestStateStore.h"
+
+void FQuestStateStore::Reset(const UQuestData* InQuestDatabase)
+{
+	QuestDatabase = InQuestDatabase;
+
+	const int32 NumQuests = (InQuestDatabase != nullptr) ? InQuestDatabase->QuestData.Num() : 0;
+
+	Accepted.Init(false, NumQuests);
+	Completed.Init(false, NumQuests);
+	Progress.Empty();
+	ObjectiveProgress.Empty();
+	AcceptOrder.Empty();
+	Unresolved.Empty();
+
+	DirtyFlags.Init(false, NumQuests);
+	DirtyEntries.Empty();
+}
+
+int32 FQuestStateStore::ResolveQuestIndex(FName QuestID) const
+{
+	const UQuestData* Database = QuestDatabase.Get();
+
+	if (Database == nullptr) { return INDEX_NONE; }
+
+	const int32 QuestIndex = Database->FindQuestIndex(QuestID);
+
+	// The bitsets are sized when the store is reset, ignore quests added to the asset afterwards
+	return Accepted.IsValidIndex(QuestIndex) ? QuestIndex : INDEX_NONE;
+}
+
+int32 FQuestStateStore::GetProgress(int32 QuestIndex) const
+{
+	const int32* Value = Progress.Find(QuestIndex);
+	return (Value != nullptr) ? *Value : 0;
+}
+
+void FQuestStateStore::SetProgress(int32 QuestIndex, int32 Value)
+{
+	MarkDirty(QuestIndex);
+
+	if (Value != 0)
+	{
+		Progress.Add(QuestIndex, Value);
+	}
+	else
+	{
+		Progress.Remove(QuestIndex);
+	}
+}
+
+int32 FQuestStateStore::GetObjectiveProgress(int32 QuestIndex, int32 ObjectiveIndex) const
+{
+	const TArray<int32>* Counts = ObjectiveProgress.Find(QuestIndex);
+	return ((Counts != nullptr) && Counts->IsValidIndex(ObjectiveIndex)) ? (*Counts)[ObjectiveIndex] : 0;
+}
+
+void FQuestStateStore::SetObjectiveProgress(int32 QuestIndex, int32 ObjectiveIndex, int32 Value)
+{
+	MarkDirty(QuestIndex);
+
+	TArray<int32>& Counts = ObjectiveProgress.FindOrAdd(QuestIndex);
+
+	if (Counts.Num() <= ObjectiveIndex)
+	{
+		Counts.SetNumZeroed(ObjectiveIndex + 1);
+	}
+
+	Counts[ObjectiveIndex] = Value;
+}
+
+bool FQuestStateStore::Find(FName QuestID, FQuestItem& OutQuest) const
+{
+	const int32 QuestIndex = ResolveQuestIndex(QuestID);
+
+	if (QuestIndex != INDEX_NONE)
+	{
+		if (!Accepted[QuestIndex]) { return false; }
+
+		FillQuestItem(QuestIndex, OutQuest);
+		return true;
+	}
+
+	const int32 UnresolvedIndex = FindUnresolved(QuestID);
+
+	if (UnresolvedIndex != INDEX_NONE)
+	{
+		OutQuest = Unresolved[UnresolvedIndex];
+		return true;
+	}
+
+	return false;
+}
+
+bool FQuestStateStore::Accept(FName QuestID)
+{
+	const int32 QuestIndex = ResolveQuestIndex(QuestID);
+
+	if (QuestIndex != INDEX_NONE)
+	{
+		if (Accepted[QuestIndex]) { return false; }
+
+		Accepted[QuestIndex] = true;
+		AcceptOrder.Add(QuestIndex);
+		MarkDirty(QuestIndex);
+		return true;
+	}
+
+	if (FindUnresolved(QuestID) != INDEX_NONE) { return false; }
+
+	FQuestItem NewQuest;
+	NewQuest.QuestID = QuestID;
+	NewQuest.IsCompleted = false;
+
+	const int32 Entry = EncodeUnresolved(Unresolved.Add(NewQuest));
+	AcceptOrder.Add(Entry);
+	MarkDirty(Entry);
+	return true;
+}
+
+bool FQuestStateStore::MarkCompleted(FName QuestID)
+{
+	const int32 QuestIndex = ResolveQuestIndex(QuestID);
+
+	if (QuestIndex != INDEX_NONE)
+	{
+		if (!Accepted[QuestIndex] || Completed[QuestIndex]) { return false; }
+
+		Completed[QuestIndex] = true;
+		MarkDirty(QuestIndex);
+		return true;
+	}
+
+	const int32 UnresolvedIndex = FindUnresolved(QuestID);
+
+	if ((UnresolvedIndex == INDEX_NONE) || Unresolved[UnresolvedIndex].IsCompleted) { return false; }
+
+	Unresolved[UnresolvedIndex].IsCompleted = true;
+	MarkDirty(EncodeUnresolved(UnresolvedIndex));
+	return true;
+}
+
+void FQuestStateStore::FromQuestItems(const TArray<FQuestItem>& QuestItems)
+{
+	Reset(QuestDatabase.Get());
+
+	for (const FQuestItem& Quest : QuestItems)
+	{
+		const int32 QuestIndex = ResolveQuestIndex(Quest.QuestID);
+
+		if (QuestIndex != INDEX_NONE)
+		{
+			// First entry wins, like the old linear search did
+			if (Accepted[QuestIndex]) { continue; }
+
+			Accepted[QuestIndex] = true;
+			Completed[QuestIndex] = Quest.IsCompleted;
+			SetProgress(QuestIndex, Quest.Progress);
+
+			if (Quest.ObjectiveProgress.Num() > 0)
+			{
+				ObjectiveProgress.Add(QuestIndex, Quest.ObjectiveProgress);
+			}
+			AcceptOrder.Add(QuestIndex);
+		}
+		else if (FindUnresolved(Quest.QuestID) == INDEX_NONE)
+		{
+			AcceptOrder.Add(EncodeUnresolved(Unresolved.Add(Quest)));
+		}
+	}
+
+	// This is the saved state, nothing to journal
+	ClearDirty();
+}
+
+void FQuestStateStore::ToQuestItems(TArray<FQuestItem>& OutQuestItems) const
+{
+	OutQuestItems.Reset(AcceptOrder.Num());
+
+	for (int32 Entry : AcceptOrder)
+	{
+		FillQuestItem(Entry, OutQuestItems.AddDefaulted_GetRef());
+	}
+}
+
+void FQuestStateStore::ConsumeDirtyQuests(TArray<FQuestItem>& OutQuestItems)
+{
+	OutQuestItems.Reset(DirtyEntries.Num());
+
+	for (int32 Entry : DirtyEntries)
+	{
+		// Progress set on a quest that was never accepted is not saved
+		if ((Entry >= 0) && !Accepted[Entry]) continue;
+
+		FillQuestItem(Entry, OutQuestItems.AddDefaulted_GetRef());
+	}
+
+	ClearDirty();
+}
+
+void FQuestStateStore::MarkDirty(int32 Entry)
+{
+	if (Entry >= 0)
+	{
+		if (!DirtyFlags.IsValidIndex(Entry) || DirtyFlags[Entry]) return;
+
+		DirtyFlags[Entry] = true;
+		DirtyEntries.Add(Entry);
+	}
+	else
+	{
+		DirtyEntries.AddUnique(Entry);
+	}
+}
+
+void FQuestStateStore::ClearDirty()
+{
+	for (int32 Entry : DirtyEntries)
+	{
+		if (Entry >= 0)
+		{
+			DirtyFlags[Entry] = false;
+		}
+	}
+
+	DirtyEntries.Reset();
+}
+
+int32 FQuestStateStore::FindUnresolved(FName QuestID) const
+{
+	// Only quests missing from the database end up here, this list is normally empty
+	return Unresolved.IndexOfByPredicate([QuestID](const FQuestItem& Quest) { return Quest.QuestID == QuestID; });
+}
+
+void FQuestStateStore::FillQuestItem(int32 Entry, FQuestItem& OutQuest) const
+{
+	if (Entry < 0)
+	{
+		OutQuest = Unresolved[DecodeUnresolved(Entry)];
+		return;
+	}
+
+	OutQuest.QuestID = QuestDatabase->QuestData[Entry].QuestID;
+	OutQuest.IsCompleted = Completed[Entry];
+	OutQuest.Progress = GetProgress(Entry);
+
+	const TArray<int32>* Counts = ObjectiveProgress.Find(Entry);
+	if (Counts != nullptr)
+	{
+		OutQuest.ObjectiveProgress = *Counts;
+	}
+	else
+	{
+		OutQuest.ObjectiveProgress.Reset();
+	}
+}
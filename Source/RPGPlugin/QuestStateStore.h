@@ -0,0 +1,118 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ItemData.h"
+
+/**
+ * Quest state of a character, keyed by the index of the quest in UQuestData.
+ * Accepted/completed flags live in bitsets and progress in a sparse map, so lookups are O(1).
+ * Quests that are not in the database are kept apart, so saves convert back without losing anything.
+ */
+struct RPGPLUGIN_API FQuestStateStore
+{
+public:
+
+	// Binds the database used to resolve quest IDs and clears the state
+	void Reset(const UQuestData* InQuestDatabase);
+
+	const UQuestData* GetQuestDatabase() const { return QuestDatabase.Get(); }
+
+	// Index of the quest on the database, INDEX_NONE if it can't be resolved
+	int32 ResolveQuestIndex(FName QuestID) const;
+
+	//// Index based access ///////
+
+	bool IsAccepted(int32 QuestIndex) const { return Accepted.IsValidIndex(QuestIndex) && Accepted[QuestIndex]; }
+
+	bool IsCompleted(int32 QuestIndex) const { return Completed.IsValidIndex(QuestIndex) && Completed[QuestIndex]; }
+
+	int32 GetProgress(int32 QuestIndex) const;
+
+	void SetProgress(int32 QuestIndex, int32 Value);
+
+	int32 GetObjectiveProgress(int32 QuestIndex, int32 ObjectiveIndex) const;
+
+	void SetObjectiveProgress(int32 QuestIndex, int32 ObjectiveIndex, int32 Value);
+
+	//// ID based access ///////
+
+	bool Find(FName QuestID, FQuestItem& OutQuest) const;
+
+	// Returns false if the quest was already accepted
+	bool Accept(FName QuestID);
+
+	// Returns false if the quest is not accepted or already completed
+	bool MarkCompleted(FName QuestID);
+
+	int32 Num() const { return AcceptOrder.Num(); }
+
+	// Calls Func(QuestID, QuestIndex) for every accepted quest not completed yet, in acceptance order.
+	// QuestIndex is INDEX_NONE for quests not found on the database
+	template<typename FuncType>
+	void ForEachActiveQuest(FuncType Func) const
+	{
+		for (int32 Entry : AcceptOrder)
+		{
+			if (Entry >= 0)
+			{
+				if (!Completed[Entry])
+				{
+					Func(QuestDatabase->QuestData[Entry].QuestID, Entry);
+				}
+			}
+			else
+			{
+				const FQuestItem& Quest = Unresolved[DecodeUnresolved(Entry)];
+				if (!Quest.IsCompleted)
+				{
+					Func(Quest.QuestID, INDEX_NONE);
+				}
+			}
+		}
+	}
+
+	//// Save conversion ///////
+
+	void FromQuestItems(const TArray<FQuestItem>& QuestItems);
+
+	void ToQuestItems(TArray<FQuestItem>& OutQuestItems) const;
+
+	// Quests changed since the last call, for the save journal
+	void ConsumeDirtyQuests(TArray<FQuestItem>& OutQuestItems);
+
+private:
+
+	// Entries of AcceptOrder are quest indices, or encoded indices into Unresolved when negative
+	static int32 EncodeUnresolved(int32 UnresolvedIndex) { return -(UnresolvedIndex + 1); }
+	static int32 DecodeUnresolved(int32 Entry) { return -Entry - 1; }
+
+	int32 FindUnresolved(FName QuestID) const;
+
+	void FillQuestItem(int32 Entry, FQuestItem& OutQuest) const;
+
+	void MarkDirty(int32 Entry);
+
+	void ClearDirty();
+
+	TWeakObjectPtr<const UQuestData> QuestDatabase;
+
+	TBitArray<> Accepted;
+
+	TBitArray<> Completed;
+
+	TMap<int32, int32> Progress;
+
+	// Only quests with objective counts have an entry
+	TMap<int32, TArray<int32>> ObjectiveProgress;
+
+	TArray<int32> AcceptOrder;
+
+	TArray<FQuestItem> Unresolved;
+
+	// Same encoding as AcceptOrder
+	TArray<int32> DirtyEntries;
+
+	TBitArray<> DirtyFlags;
+};
@@ -3,3 +3,6 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "Stats/Stats.h"
+
+DECLARE_STATS_GROUP(TEXT("RPGPlugin"), STATGROUP_RPGPlugin, STATCAT_Advanced);
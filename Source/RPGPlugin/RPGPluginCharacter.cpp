@@ -10,6 +10,15 @@
 #include "RPGPluginGameMode.h"
 #include "Kismet/KismetSystemLibrary.h"
 #include "RPGPluginGameInstance.h"
+#include "QuestObjectiveSubsystem.h"
+#include "AssetStreamingSubsystem.h"
+#include "ItemActorPoolComponent.h"
+#include "WorldStateSubsystem.h"
+#include "BasicInteractive.h"
+#include "DamageQueueSubsystem.h"
+#include "MeleeHitSubsystem.h"
+#include "TimerManager.h"
+#include "Engine/Texture2D.h"
 #include "GameFramework/SpringArmComponent.h"
 #include <Runtime/Engine/Classes/Kismet/GameplayStatics.h>
 
@@ -55,6 +64,8 @@ ARPGPluginCharacter::ARPGPluginCharacter()
 	CarryItemPoint = CreateDefaultSubobject<USceneComponent>(TEXT("CarryItemPoint"));
 	CarryItemPoint->SetupAttachment(RootComponent);
 
+	ItemActorPool = CreateDefaultSubobject<UItemActorPoolComponent>(TEXT("ItemActorPool"));
+
 	// Note: The skeletal mesh and anim blueprint references on the Mesh component (inherited from Character) 
 	// are set in the derived blueprint asset named ThirdPersonCharacter (to avoid direct content references in C++)
 
@@ -76,6 +87,11 @@ ARPGPluginCharacter::ARPGPluginCharacter()
 
 	attackSpeed = 1.0f;
 
+	punchDamage = 0.05f;
+	weaponDamageScale = 0.01f;
+	meleeReach = 150.0f;
+	meleeRadius = 50.0f;
+
 	isZoomedIn = false;
 }
 
@@ -84,6 +100,11 @@ ARPGPluginCharacter::ARPGPluginCharacter()
 
 void ARPGPluginCharacter::BeginPlay()
 {
+	// Before the pool begins play, prewarmed actors already go to the right place
+	ItemActorPool->SetAttachPoint(CarryItemPoint);
+	// A single held actor doesn't need idle actors following the hands
+	ItemActorPool->SetAttachFreeActors(!bMaterializeOnlyHeldItem);
+
 	Super::BeginPlay();
 
 	if (GetMesh() != nullptr)
@@ -92,24 +113,128 @@ void ARPGPluginCharacter::BeginPlay()
 	}
 
 
-	OnRefreshInventory();
+	MarkInventorySlotsDirty(0, EquipmentInventory.Num());
 
 
-	QuestList.Empty();
+	ARPGPluginGameMode* GameMode = Cast<ARPGPluginGameMode>(GetWorld()->GetAuthGameMode());
+	QuestState.Reset((GameMode != nullptr) ? GameMode->GetQuestDatabase() : nullptr);
+	ItemDatabase = (GameMode != nullptr) ? GameMode->GetItemDatabase() : nullptr;
+
 	// Load game
 	URPGPluginGameInstance* GameInstance = Cast<URPGPluginGameInstance>(UGameplayStatics::GetGameInstance(GetWorld()));
 
-	if ((GameInstance != nullptr) && (GameInstance->LoadGame()))
+	if (GameInstance != nullptr)
+	{
+		if (GameInstance->IsSaveGamePreloading())
+		{
+			// Still reading the slot, wait for it instead of reading it twice
+			SaveGameLoadedHandle = GameInstance->OnSaveGameLoaded.AddUObject(this, &ARPGPluginCharacter::ApplySaveGame);
+		}
+		else if (GameInstance->LoadGame())
+		{
+			ApplySaveGame(GameInstance->CurrentSaveGame);
+		}
+	}
+
+}
+
+void ARPGPluginCharacter::ApplySaveGame(UMainSaveGame* SaveGame)
+{
+	URPGPluginGameInstance* GameInstance = Cast<URPGPluginGameInstance>(UGameplayStatics::GetGameInstance(GetWorld()));
+
+	if ((GameInstance != nullptr) && SaveGameLoadedHandle.IsValid())
+	{
+		GameInstance->OnSaveGameLoaded.Remove(SaveGameLoadedHandle);
+		SaveGameLoadedHandle.Reset();
+	}
+
+	if (SaveGame == nullptr)
+	{
+		return;
+	}
+
+	// Retrieve the quest list
+	RestoreQuests(SaveGame->QuestStatus);
+
+	// Retrieve the inventory
+	RestoreInventory(SaveGame->Inventory);
+}
+
+void ARPGPluginCharacter::RestoreQuests(const TArray<FQuestItem>& SavedQuests)
+{
+	UQuestObjectiveSubsystem* QuestObjectives = GetQuestObjectives();
+
+	if (QuestObjectives != nullptr)
+	{
+		QuestObjectives->UnsubscribeCharacter(this);
+	}
+
+	QuestState.FromQuestItems(SavedQuests);
+
+	// Listen again for the objectives of the quests still running
+	if ((QuestObjectives != nullptr) && (QuestState.GetQuestDatabase() != nullptr))
 	{
-		if (GameInstance->CurrentSaveGame != nullptr)
+		QuestState.ForEachActiveQuest([this, QuestObjectives](FName QuestID, int32 QuestIndex)
 		{
-			// Retrieve the quest list
-			QuestList = GameInstance->CurrentSaveGame->QuestStatus;
+			if (QuestIndex != INDEX_NONE)
+			{
+				QuestObjectives->SubscribeQuest(this, QuestIndex, QuestState.GetQuestDatabase()->QuestData[QuestIndex]);
+			}
+		});
+	}
+
+	UpdateAndShowQuestList();
+}
+
+void ARPGPluginCharacter::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (InventoryRefreshHandle.IsValid())
+	{
+		FWorldDelegates::OnWorldPostActorTick.Remove(InventoryRefreshHandle);
+		InventoryRefreshHandle.Reset();
+	}
+
+	UQuestObjectiveSubsystem* QuestObjectives = GetQuestObjectives();
+	if (QuestObjectives != nullptr)
+	{
+		QuestObjectives->UnsubscribeCharacter(this);
+	}
+
+	URPGPluginGameInstance* GameInstance = Cast<URPGPluginGameInstance>(UGameplayStatics::GetGameInstance(GetWorld()));
+	if ((GameInstance != nullptr) && SaveGameLoadedHandle.IsValid())
+	{
+		GameInstance->OnSaveGameLoaded.Remove(SaveGameLoadedHandle);
+		SaveGameLoadedHandle.Reset();
+	}
+
+	// The interactives must not keep this character as their player
+	if (ABasicInteractive* Focus = Cast<ABasicInteractive>(CurrentInteractiveActor.Get()))
+	{
+		Focus->NotifyPlayerFocusEnd(this);
+	}
+
+	CurrentInteractiveActor.Reset();
+
+	// Leaving calls OnLeaveActor back, which would edit the candidates while they are walked
+	const TArray<FInteractionCandidate, TInlineAllocator<4>> Candidates = MoveTemp(InteractionCandidates);
+	InteractionCandidates.Reset();
 
-			UpdateAndShowQuestList();
+	for (const FInteractionCandidate& Candidate : Candidates)
+	{
+		if (ABasicInteractive* Interactive = Cast<ABasicInteractive>(Candidate.Actor.Get()))
+		{
+			Interactive->NotifyPlayerFocusEnd(this);
+			Interactive->NotifyPlayerEndOverlap(this);
 		}
 	}
 
+	Super::EndPlay(EndPlayReason);
+}
+
+UQuestObjectiveSubsystem* ARPGPluginCharacter::GetQuestObjectives() const
+{
+	UWorld* World = GetWorld();
+	return (World != nullptr) ? World->GetSubsystem<UQuestObjectiveSubsystem>() : nullptr;
 }
 
 void ARPGPluginCharacter::SetupPlayerInputComponent(class UInputComponent* PlayerInputComponent)
@@ -240,13 +365,27 @@ void ARPGPluginCharacter::StopZoom()
 	}
 }
 
-void ARPGPluginCharacter::TakeDamage(float _damageAmount)
+void ARPGPluginCharacter::TakeDamage(float _damageAmount, AActor* _source)
+{
+	if (UDamageQueueSubsystem* DamageQueue = GetWorld()->GetSubsystem<UDamageQueueSubsystem>())
+	{
+		DamageQueue->QueueDamage(_source, this, _damageAmount);
+		return;
+	}
+
+	if (ResolveDamage(_damageAmount, 0.0f))
+	{
+		OnDied();
+	}
+}
+
+bool ARPGPluginCharacter::ResolveDamage(float ArmoredDamage, float PiercingDamage)
 {
-	UE_LOG(LogTemp, Warning, TEXT("We are taking damage for %f points."), _damageAmount);
+	const bool bWasAlive = (playerHealth > 0.00f);
 
 	if (hasArmor)
 	{
-		playerArmor -= _damageAmount;
+		playerArmor -= ArmoredDamage;
 
 		if (playerArmor < 0.00f)
 		{
@@ -257,13 +396,17 @@ void ARPGPluginCharacter::TakeDamage(float _damageAmount)
 	}
 	else
 	{
-		playerHealth -= _damageAmount;
+		playerHealth -= ArmoredDamage;
+	}
 
-		if (playerHealth < 0.00f)
-		{
-			playerHealth = 0.00f;
-		}
+	playerHealth -= PiercingDamage;
+
+	if (playerHealth < 0.00f)
+	{
+		playerHealth = 0.00f;
 	}
+
+	return bWasAlive && (playerHealth <= 0.00f);
 }
 
 void ARPGPluginCharacter::StartHealing()
@@ -308,28 +451,137 @@ void ARPGPluginCharacter::GainExperience(float _expAmount)
 
 void ARPGPluginCharacter::Punch()
 {
+	// Swings per second: the character attack speed times the weapon speed
+	const float SwingRate = attackSpeed * ((currentWeapon != nullptr) ? currentWeapon->GetBaseSpeed() : 1.0f);
+	const float Now = GetWorld()->GetTimeSeconds();
+
+	if ((SwingRate <= 0.0f) || (Now < NextSwingTime)) return;
+
+	NextSwingTime = Now + 1.0f / SwingRate;
+
 	hasPunched = true;
+
+	// The hits are found by an async sweep and land on the next frame
+	if (UMeleeHitSubsystem* MeleeHits = GetWorld()->GetSubsystem<UMeleeHitSubsystem>())
+	{
+		const float Damage = (currentWeapon != nullptr) ? currentWeapon->GetBaseDamage() * weaponDamageScale : punchDamage;
+		const FVector Forward = GetActorForwardVector();
+		const FVector Location = GetActorLocation();
+
+		MeleeHits->QueueSwing(this, Location + Forward * meleeRadius, Location + Forward * meleeReach, meleeRadius, Damage);
+	}
 }
 
 void ARPGPluginCharacter::OnEnterActor(AActor* InteractiveActor)
 {
-	if (InteractiveActor != nullptr)
+	if (InteractiveActor == nullptr) return;
+
+	if (InteractionCandidates.ContainsByPredicate([InteractiveActor](const FInteractionCandidate& Candidate) { return Candidate.Actor == InteractiveActor; })) return;
+
+	bool IsInterface = UKismetSystemLibrary::DoesImplementInterface(InteractiveActor, UInteractable::StaticClass());
+	if (IsInterface)
 	{
-		bool IsInterface = UKismetSystemLibrary::DoesImplementInterface(InteractiveActor, UInteractable::StaticClass());
-		if (IsInterface)
-		{
-			CurrentInteractiveActor = InteractiveActor;
+		FInteractionCandidate& Candidate = InteractionCandidates.AddDefaulted_GetRef();
+		Candidate.Actor = InteractiveActor;
+		Candidate.BasicInteractive = Cast<ABasicInteractive>(InteractiveActor);
 
-			CurrentInteractive = Cast<IInteractable>(InteractiveActor);
+		UpdateInteractionFocus();
+
+		// Moving or turning the camera changes the scores too
+		if (!InteractionFocusTimer.IsValid())
+		{
+			GetWorldTimerManager().SetTimer(InteractionFocusTimer, this, &ARPGPluginCharacter::UpdateInteractionFocus, InteractionFocusInterval, true);
 		}
 	}
 }
 
 
-void ARPGPluginCharacter::OnLeaveActor()
+void ARPGPluginCharacter::OnLeaveActor(AActor* InteractiveActor)
+{
+	const int32 NumRemoved = InteractionCandidates.RemoveAllSwap([InteractiveActor](const FInteractionCandidate& Candidate) { return Candidate.Actor == InteractiveActor; });
+
+	if (NumRemoved > 0)
+	{
+		UpdateInteractionFocus();
+	}
+}
+
+void ARPGPluginCharacter::Interact()
+{
+	AActor* Focus = CurrentInteractiveActor.Get();
+
+	if (Focus == nullptr) return;
+
+	// Other players may be focusing it too
+	if (ABasicInteractive* Interactive = Cast<ABasicInteractive>(Focus))
+	{
+		Interactive->SetInteractingPlayer(this);
+	}
+
+	IInteractable::Execute_OnInteract(Focus);
+}
+
+void ARPGPluginCharacter::UpdateInteractionFocus()
+{
+	InteractionCandidates.RemoveAllSwap([](const FInteractionCandidate& Candidate) { return !Candidate.Actor.IsValid(); });
+
+	const FVector ViewLocation = GetActorLocation();
+	const FVector ViewDirection = (Controller != nullptr) ? Controller->GetControlRotation().Vector() : GetActorForwardVector();
+
+	const FInteractionCandidate* Best = nullptr;
+	float BestScore = -MAX_flt;
+
+	for (const FInteractionCandidate& Candidate : InteractionCandidates)
+	{
+		const FVector ToCandidate = Candidate.Actor->GetActorLocation() - ViewLocation;
+		const float Distance = ToCandidate.Size();
+
+		float Score = FVector::DotProduct(ViewDirection, ToCandidate.GetSafeNormal()) * InteractionViewWeight
+			- (Distance / 100.0f) * InteractionDistanceWeight;
+
+		if (Candidate.Actor == CurrentInteractiveActor)
+		{
+			Score += InteractionFocusStickiness;
+		}
+
+		if (Score > BestScore)
+		{
+			BestScore = Score;
+			Best = &Candidate;
+		}
+	}
+
+	SetInteractionFocus(Best);
+
+	if ((InteractionCandidates.Num() == 0) && InteractionFocusTimer.IsValid())
+	{
+		GetWorldTimerManager().ClearTimer(InteractionFocusTimer);
+	}
+}
+
+void ARPGPluginCharacter::SetInteractionFocus(const FInteractionCandidate* Candidate)
 {
-	CurrentInteractive = nullptr;
-	CurrentInteractiveActor = nullptr;
+	AActor* NewFocus = (Candidate != nullptr) ? Candidate->Actor.Get() : nullptr;
+	AActor* OldFocus = CurrentInteractiveActor.Get();
+
+	if (NewFocus == OldFocus) return;
+
+	ABasicInteractive* OldInteractive = Cast<ABasicInteractive>(OldFocus);
+
+	CurrentInteractiveActor = NewFocus;
+
+	// Old one first, so the UI ends showing the new one
+	if (OldInteractive != nullptr)
+	{
+		OldInteractive->NotifyPlayerFocusEnd(this);
+	}
+
+	if ((Candidate != nullptr) && (Candidate->BasicInteractive != nullptr))
+	{
+		Candidate->BasicInteractive->NotifyPlayerFocusBegin(this);
+	}
+
+	OnInteractionFocusChanged(NewFocus, OldFocus);
 }
 
 //void ANewRPGCharacter::Action()
@@ -343,53 +595,171 @@ void ARPGPluginCharacter::OnLeaveActor()
 
 bool ARPGPluginCharacter::FindQuest(FName QuestID, FQuestItem& Quest)
 {
-	for (int i = 0; i < QuestList.Num(); i++)
+	return QuestState.Find(QuestID, Quest);
+}
+
+
+void ARPGPluginCharacter::AcceptQuest(FName QuestID)
+{
+	if (!CanAcceptQuest(QuestID)) return;
+
+	if (!QuestState.Accept(QuestID)) return;
+
+	OnQuestAddedDelegate.Broadcast(QuestID);
+
+	const int32 QuestIndex = QuestState.ResolveQuestIndex(QuestID);
+	UQuestObjectiveSubsystem* QuestObjectives = GetQuestObjectives();
+	if ((QuestIndex != INDEX_NONE) && (QuestObjectives != nullptr))
+	{
+		QuestObjectives->SubscribeQuest(this, QuestIndex, QuestState.GetQuestDatabase()->QuestData[QuestIndex]);
+	}
+
+	if (!bQuestListDeltaUpdates)
+	{
+		UpdateAndShowQuestList();
+		return;
+	}
+
+	// Only the new entry goes to the widget
+	ARPGPluginGameMode* GameMode = Cast<ARPGPluginGameMode>(GetWorld()->GetAuthGameMode());
+	const FQuest* Quest = (GameMode != nullptr) ? GameMode->FindQuestData(QuestID) : nullptr;
+
+	if (Quest != nullptr)
+	{
+		OnQuestListEntryAdded(QuestID, Quest->SortDescription);
+	}
+}
+
+void ARPGPluginCharacter::MarkQuestCompleted(FName QuestID)
+{
+	const bool bChanged = QuestState.MarkCompleted(QuestID);
+
+	if (bChanged)
 	{
-		if (QuestList[i].QuestID == QuestID)
+		const int32 QuestIndex = QuestState.ResolveQuestIndex(QuestID);
+		UQuestObjectiveSubsystem* QuestObjectives = GetQuestObjectives();
+		if ((QuestIndex != INDEX_NONE) && (QuestObjectives != nullptr))
 		{
-			Quest = QuestList[i];
-			return true;
+			QuestObjectives->UnsubscribeQuest(this, QuestIndex, QuestState.GetQuestDatabase()->QuestData[QuestIndex]);
 		}
+
+		OnQuestCompletedDelegate.Broadcast(QuestID);
+	}
+
+	if (!bQuestListDeltaUpdates)
+	{
+		UpdateAndShowQuestList();
+	}
+	else if (bChanged)
+	{
+		// Completed quests leave the list
+		OnQuestListEntryRemoved(QuestID);
 	}
-	return false;
 }
 
+void ARPGPluginCharacter::SetQuestProgress(FName QuestID, int32 Progress)
+{
+	const int32 QuestIndex = QuestState.ResolveQuestIndex(QuestID);
 
-void ARPGPluginCharacter::AcceptQuest(FName QuestID)
+	if ((QuestIndex == INDEX_NONE) || !QuestState.IsAccepted(QuestIndex)) return;
+
+	if (QuestState.GetProgress(QuestIndex) == Progress) return;
+
+	QuestState.SetProgress(QuestIndex, Progress);
+
+	OnQuestProgressDelegate.Broadcast(QuestID, Progress);
+
+	// Progress is not part of the full list, only the delta mode widget shows it
+	if (bQuestListDeltaUpdates && !QuestState.IsCompleted(QuestIndex))
+	{
+		OnQuestListEntryProgress(QuestID, Progress);
+	}
+}
+
+bool ARPGPluginCharacter::CanAcceptQuest(FName QuestID) const
 {
-	bool QuestFound = false;
-	for (int i = 0; i < QuestList.Num(); i++)
+	const UQuestData* QuestDatabase = QuestState.GetQuestDatabase();
+	const FQuest* Quest = (QuestDatabase != nullptr) ? QuestDatabase->FindQuest(QuestID) : nullptr;
+
+	if (Quest == nullptr) return true;
+
+	for (const FName& Prerequisite : Quest->Prerequisites)
 	{
-		if (QuestList[i].QuestID == QuestID)
+		const int32 PrerequisiteIndex = QuestState.ResolveQuestIndex(Prerequisite);
+
+		if ((PrerequisiteIndex == INDEX_NONE) || !QuestState.IsCompleted(PrerequisiteIndex))
 		{
-			QuestFound = true;
-			break;
+			return false;
 		}
 	}
 
-	if (!QuestFound)
-	{
-		FQuestItem NewQuest;
-		NewQuest.QuestID = QuestID;
-		NewQuest.IsCompleted = false;
-		QuestList.Add(NewQuest);
+	return true;
+}
 
-		UpdateAndShowQuestList();
+bool ARPGPluginCharacter::AreQuestObjectivesDone(FName QuestID) const
+{
+	const int32 QuestIndex = QuestState.ResolveQuestIndex(QuestID);
+	if (QuestIndex == INDEX_NONE) return true;
+
+	const int32 NumObjectives = QuestState.GetQuestDatabase()->QuestData[QuestIndex].Objectives.Num();
+
+	for (int i = 0; i < NumObjectives; i++)
+	{
+		if (!IsQuestObjectiveDone(QuestIndex, i))
+		{
+			return false;
+		}
 	}
+
+	return true;
 }
 
-void ARPGPluginCharacter::MarkQuestCompleted(FName QuestID)
+bool ARPGPluginCharacter::IsQuestObjectiveDone(int32 QuestIndex, int32 ObjectiveIndex) const
+{
+	const UQuestData* QuestDatabase = QuestState.GetQuestDatabase();
+	const FQuest* Quest = (QuestDatabase != nullptr) ? QuestDatabase->GetQuestByIndex(QuestIndex) : nullptr;
+
+	if ((Quest == nullptr) || !Quest->Objectives.IsValidIndex(ObjectiveIndex)) return true;
+
+	return QuestState.GetObjectiveProgress(QuestIndex, ObjectiveIndex) >= Quest->Objectives[ObjectiveIndex].RequiredCount;
+}
+
+bool ARPGPluginCharacter::AdvanceQuestObjective(int32 QuestIndex, int32 ObjectiveIndex, int32 Amount)
 {
-	for (int i = 0; i < QuestList.Num(); i++)
+	const UQuestData* QuestDatabase = QuestState.GetQuestDatabase();
+	const FQuest* Quest = (QuestDatabase != nullptr) ? QuestDatabase->GetQuestByIndex(QuestIndex) : nullptr;
+
+	if ((Quest == nullptr) || !Quest->Objectives.IsValidIndex(ObjectiveIndex)) return true;
+
+	if (!QuestState.IsAccepted(QuestIndex) || QuestState.IsCompleted(QuestIndex)) return true;
+
+	const int32 RequiredCount = Quest->Objectives[ObjectiveIndex].RequiredCount;
+	const int32 Count = FMath::Min(QuestState.GetObjectiveProgress(QuestIndex, ObjectiveIndex) + Amount, RequiredCount);
+
+	QuestState.SetObjectiveProgress(QuestIndex, ObjectiveIndex, Count);
+
+	if (Count < RequiredCount) return false;
+
+	// Quest progress is the number of objectives done
+	int32 ObjectivesDone = 0;
+	for (int i = 0; i < Quest->Objectives.Num(); i++)
 	{
-		if ((QuestList[i].QuestID == QuestID) && (!QuestList[i].IsCompleted))
+		if (IsQuestObjectiveDone(QuestIndex, i))
 		{
-			QuestList[i].IsCompleted = true;
-			break;
+			ObjectivesDone++;
 		}
 	}
 
-	UpdateAndShowQuestList();
+	SetQuestProgress(Quest->QuestID, ObjectivesDone);
+
+	// Quests with an item to deliver are completed on the chest
+	if ((ObjectivesDone == Quest->Objectives.Num()) && Quest->ItemID.IsNone())
+	{
+		MarkQuestCompleted(Quest->QuestID);
+		OnShowQuestCompleted(Quest->CompleteMessage);
+	}
+
+	return true;
 }
 
 void ARPGPluginCharacter::UpdateAndShowQuestList()
@@ -400,20 +770,16 @@ void ARPGPluginCharacter::UpdateAndShowQuestList()
 	if (GameMode != nullptr)
 	{
 		TArray<FText> QuestTextList;
-		for (int i = 0; i < QuestList.Num(); i++)
+		QuestState.ForEachActiveQuest([GameMode, &QuestTextList](FName QuestID, int32 QuestIndex)
 		{
-			if (!QuestList[i].IsCompleted)
-			{
-				bool Success = false;
-				// Find the quest on the game mode
-				FQuest Quest = GameMode->FindQuest(QuestList[i].QuestID, Success);
+			// Find the quest on the game mode
+			const FQuest* Quest = (QuestIndex != INDEX_NONE) ? GameMode->GetQuestByIndex(QuestIndex) : GameMode->FindQuestData(QuestID);
 
-				if (Success)
-				{
-					QuestTextList.Add(Quest.SortDescription);
-				}
+			if (Quest != nullptr)
+			{
+				QuestTextList.Add(Quest->SortDescription);
 			}
-		}
+		});
 
 		OnShowUpdatedQuestList(QuestTextList);
 	}
@@ -436,6 +802,36 @@ void ARPGPluginCharacter::UpdateAndShowQuestList()
 //}
 
 
+void ARPGPluginCharacter::ShowQuestInfo(FName QuestID)
+{
+	ARPGPluginGameMode* GameMode = Cast<ARPGPluginGameMode>(GetWorld()->GetAuthGameMode());
+	const FQuest* Quest = (GameMode != nullptr) ? GameMode->FindQuestData(QuestID) : nullptr;
+
+	if (Quest == nullptr) return;
+
+	UAssetStreamingSubsystem* AssetStreaming = GetGameInstance()->GetSubsystem<UAssetStreamingSubsystem>();
+
+	// Show the popup once its texture is in memory
+	if (Quest->ItemQuestTexture.IsNull() || (Quest->ItemQuestTexture.Get() != nullptr) || (AssetStreaming == nullptr))
+	{
+		OnQuestInfoStreamed(QuestID);
+		return;
+	}
+
+	AssetStreaming->RequestAsset(Quest->ItemQuestTexture.ToSoftObjectPath(), FStreamableDelegate::CreateUObject(this, &ARPGPluginCharacter::OnQuestInfoStreamed, QuestID));
+}
+
+void ARPGPluginCharacter::OnQuestInfoStreamed(FName QuestID)
+{
+	ARPGPluginGameMode* GameMode = Cast<ARPGPluginGameMode>(GetWorld()->GetAuthGameMode());
+	const FQuest* Quest = (GameMode != nullptr) ? GameMode->FindQuestData(QuestID) : nullptr;
+
+	if (Quest != nullptr)
+	{
+		OnShowQuestInfo(*Quest);
+	}
+}
+
 void ARPGPluginCharacter::TriggerCheckPoint_Implementation()
 {
 	// Save current game
@@ -443,12 +839,16 @@ void ARPGPluginCharacter::TriggerCheckPoint_Implementation()
 
 	if ((GameInstance != nullptr) && (GameInstance->CurrentSaveGame != nullptr))
 	{
-		GameInstance->CurrentSaveGame->QuestStatus.Empty();
-		GameInstance->CurrentSaveGame->QuestStatus = QuestList;
+		// Only what changed since the last checkpoint is written
+		TArray<FSaveJournalRecord> Records;
+		GatherJournalRecords(Records);
 
-		if (GameInstance->SaveGame())
+		if (GameInstance->AppendToJournal(MoveTemp(Records)))
 		{
-			UE_LOG(LogTemp, Warning, TEXT("[AHowToCharacter::TriggerCheckPoint] Success saving game"));
+			UE_LOG(LogTemp, Warning, TEXT("[AHowToCharacter::TriggerCheckPoint] Saving game"));
+
+			// Same state as the journal now has, a respawn rolls back to it
+			TakeCheckpointSnapshot();
 
 			return;
 		}
@@ -457,138 +857,352 @@ void ARPGPluginCharacter::TriggerCheckPoint_Implementation()
 	UE_LOG(LogTemp, Warning, TEXT("[AHowToCharacter::TriggerCheckPoint] Fail saving game"));
 }
 
+void ARPGPluginCharacter::TakeCheckpointSnapshot()
+{
+	FCheckpointSnapshot& Snapshot = CheckpointSnapshot;
 
+	Snapshot.Transform = GetActorTransform();
+	Snapshot.ControlRotation = GetControlRotation();
 
-//// Inventory ///////
+	Snapshot.Health = playerHealth;
+	Snapshot.Armor = playerArmor;
+	Snapshot.bHasArmor = hasArmor;
 
-void ARPGPluginCharacter::AddItem(FName ItemID)
-{
-	// Find the item on the inventory
-	for (int i = 0; i < EquipmentInventory.Num(); i++)
-	{
-		if (EquipmentInventory[i].ItemID == ItemID)
-		{
-			EquipmentInventory[i].Quantity += 1;
+	Snapshot.ExperiencePoints = experiencePoints;
+	Snapshot.ExperienceToLevel = experienceToLevel;
+	Snapshot.Level = currentLevel;
+	Snapshot.UpgradePoints = upgradePoints;
+	Snapshot.Strength = strengthValue;
+	Snapshot.Dexterity = dexterityValue;
+	Snapshot.Intellect = intellectValue;
+	Snapshot.AttackSpeed = attackSpeed;
 
-			if (!bHasItemOnHands)
-			{
-				IndexItemOnHands = i;
-				ItemIDOnHands = ItemID;
-				bHasItemOnHands = true;
+	SaveInventory(Snapshot.Inventory);
+	QuestState.ToQuestItems(Snapshot.Quests);
 
-				EquipmentInventory[i].SpawnedItem->SetActorHiddenInGame(false);
+	if (UWorldStateSubsystem* WorldState = GetGameInstance()->GetSubsystem<UWorldStateSubsystem>())
+	{
+		WorldState->CopyFlags(Snapshot.WorldStateFlags);
+	}
 
-				Animator->SetAlphaRightArm(true);
-				Animator->SetAlphaLeftArm(true);
-			}
+	bHasCheckpoint = true;
+}
 
-			OnRefreshInventory();
-			return;
-		}
+bool ARPGPluginCharacter::RespawnAtCheckpoint()
+{
+	if (!bHasCheckpoint)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("[ARPGPluginCharacter::RespawnAtCheckpoint] No checkpoint reached yet"));
+		return false;
 	}
 
-	if (EquipmentInventory.Num() == TotalEquipmentSlots)
+	const double StartTime = FPlatformTime::Seconds();
+	const FCheckpointSnapshot& Snapshot = CheckpointSnapshot;
+
+	GetCharacterMovement()->StopMovementImmediately();
+	SetActorLocationAndRotation(Snapshot.Transform.GetLocation(), Snapshot.Transform.GetRotation(), false, nullptr, ETeleportType::TeleportPhysics);
+
+	if (Controller != nullptr)
 	{
-		UE_LOG(LogTemp, Warning, TEXT("[AHowToCharacter::AddItem] EquipmentInventory full: %d / %d "), EquipmentInventory.Num(), TotalEquipmentSlots);
-		return;
+		Controller->SetControlRotation(Snapshot.ControlRotation);
 	}
 
-	// Find the item on the table on the game mode to get the information	
-	ARPGPluginGameMode* GameMode = Cast<ARPGPluginGameMode>(GetWorld()->GetAuthGameMode());
-	if (GameMode != nullptr)
-	{
-		bool Found = false;
-		FItem ItemFound = GameMode->FindItem(ItemID, Found);
+	playerHealth = Snapshot.Health;
+	playerArmor = Snapshot.Armor;
+	hasArmor = Snapshot.bHasArmor;
 
-		if (Found && (ItemFound.ItemActor != nullptr))
-		{
-			AActor* SpawnItem = GetWorld()->SpawnActor<AActor>(ItemFound.ItemActor, FVector::ZeroVector, FRotator::ZeroRotator);
+	experiencePoints = Snapshot.ExperiencePoints;
+	experienceToLevel = Snapshot.ExperienceToLevel;
+	currentLevel = Snapshot.Level;
+	upgradePoints = Snapshot.UpgradePoints;
+	strengthValue = Snapshot.Strength;
+	dexterityValue = Snapshot.Dexterity;
+	intellectValue = Snapshot.Intellect;
+	attackSpeed = Snapshot.AttackSpeed;
 
-			// Spawn the item and add it to the list of elements
-			if (SpawnItem != nullptr)
-			{
-				FItem NewItem;
-				NewItem.ItemID = ItemID;
-				NewItem.Name = ItemFound.Name;
-				NewItem.Description = ItemFound.Description;
-				NewItem.Quantity = 1;
-				NewItem.ItemIcon = ItemFound.ItemIcon;
-				NewItem.SpawnedItem = SpawnItem;
-
-				SpawnItem->AttachToComponent(CarryItemPoint, FAttachmentTransformRules::KeepWorldTransform);
-				SpawnItem->SetActorLocation(CarryItemPoint->GetComponentLocation());
-				SpawnItem->SetActorRotation(CarryItemPoint->GetComponentRotation());
-
-				EquipmentInventory.Add(NewItem);
-
-				// Nothing on hands, we add this item on hands
-				if (!bHasItemOnHands)
-				{
-					Animator->SetAlphaRightArm(true);
-					Animator->SetAlphaLeftArm(true);
-
-					// THe index is the last one on the list
-					IndexItemOnHands = EquipmentInventory.Num() - 1;
-					ItemIDOnHands = ItemID;
-					bHasItemOnHands = true;
-					SpawnItem->SetActorHiddenInGame(false);
-				}
-				else
-				{
-					// Hide item if exists
-					SpawnItem->SetActorHiddenInGame(true);
-				}
-			}
+	// The journal already holds this state, the restores clear the changes made since the checkpoint
+	RestoreInventory(Snapshot.Inventory);
+
+	RestoreQuests(Snapshot.Quests);
+
+	if (UWorldStateSubsystem* WorldState = GetGameInstance()->GetSubsystem<UWorldStateSubsystem>())
+	{
+		WorldState->RestoreFlags(Snapshot.WorldStateFlags);
+	}
+
+	UE_LOG(LogTemp, Log, TEXT("[ARPGPluginCharacter::RespawnAtCheckpoint] Restored in %.2f ms"), (FPlatformTime::Seconds() - StartTime) * 1000.0);
+
+	OnRespawnedAtCheckpoint();
+
+	return true;
+}
+
+
+
+//// Inventory ///////
+
+FItemHandle ARPGPluginCharacter::ResolveItemHandle(FName ItemID) const
+{
+	const UItemData* Database = ItemDatabase.Get();
+	return (Database != nullptr) ? Database->FindItemHandle(ItemID) : FItemHandle();
+}
+
+const FItem* ARPGPluginCharacter::GetItemDefinition(FItemHandle Handle) const
+{
+	const UItemData* Database = ItemDatabase.Get();
+	return (Database != nullptr) ? Database->GetItem(Handle) : nullptr;
+}
+
+FName ARPGPluginCharacter::GetInventoryItemID(int32 Slot) const
+{
+	const FItem* Item = EquipmentInventory.IsValidIndex(Slot) ? GetItemDefinition(EquipmentInventory[Slot].Definition) : nullptr;
+	return (Item != nullptr) ? Item->ItemID : NAME_None;
+}
+
+bool ARPGPluginCharacter::GetInventoryItemDefinition(int32 Slot, FItem& OutItem) const
+{
+	const FItem* Item = EquipmentInventory.IsValidIndex(Slot) ? GetItemDefinition(EquipmentInventory[Slot].Definition) : nullptr;
+
+	if (Item == nullptr) return false;
+
+	OutItem = *Item;
+	return true;
+}
+
+int32 ARPGPluginCharacter::FindInventorySlot(FItemHandle Handle) const
+{
+	if (!Handle.IsValid()) return INDEX_NONE;
+
+	return EquipmentInventory.IndexOfByPredicate([Handle](const FInventoryItem& Item) { return Item.Definition == Handle; });
+}
+
+void ARPGPluginCharacter::SetInventoryItemVisible(int32 Slot, bool bVisible)
+{
+	if (!EquipmentInventory.IsValidIndex(Slot)) return;
+
+	FInventoryItem& Item = EquipmentInventory[Slot];
+
+	if (bMaterializeOnlyHeldItem)
+	{
+		// Only the item on hands has an actor, the others are just data
+		if (bVisible && (Item.SpawnedItem == nullptr))
+		{
+			// Shows the actor once it is ready
+			RequestItemActor(Item.Definition);
+			return;
+		}
+
+		if (!bVisible && (Item.SpawnedItem != nullptr))
+		{
+			ItemActorPool->Release(Item.SpawnedItem);
+			Item.SpawnedItem = nullptr;
+			return;
 		}
 	}
 
-	OnRefreshInventory();
+	if (Item.SpawnedItem != nullptr)
+	{
+		Item.SpawnedItem->SetActorHiddenInGame(!bVisible);
+	}
 }
 
+bool ARPGPluginCharacter::ShouldMaterializeSlot(int32 Slot) const
+{
+	return !bMaterializeOnlyHeldItem || (bHasItemOnHands && (IndexItemOnHands == Slot));
+}
 
-void ARPGPluginCharacter::RemoveItem(FName ItemID, bool RemoveItemFromHands)
+void ARPGPluginCharacter::RequestItemActor(FItemHandle Handle)
+{
+	const FItem* ItemData = GetItemDefinition(Handle);
+	if (ItemData == nullptr) return;
+
+	UAssetStreamingSubsystem* AssetStreaming = GetGameInstance()->GetSubsystem<UAssetStreamingSubsystem>();
+
+	if ((ItemData->ItemActor.Get() != nullptr) || (AssetStreaming == nullptr))
+	{
+		OnItemActorLoaded(Handle);
+		return;
+	}
+
+	AssetStreaming->RequestAsset(ItemData->ItemActor.ToSoftObjectPath(), FStreamableDelegate::CreateUObject(this, &ARPGPluginCharacter::OnItemActorLoaded, Handle));
+}
+
+void ARPGPluginCharacter::OnItemActorLoaded(FItemHandle Handle)
+{
+	// The item may have been removed while its class was streaming
+	const int32 Slot = FindInventorySlot(Handle);
+
+	if ((Slot == INDEX_NONE) || (EquipmentInventory[Slot].SpawnedItem != nullptr)) return;
+
+	// Switched away while streaming
+	if (!ShouldMaterializeSlot(Slot)) return;
+
+	const FItem* ItemData = GetItemDefinition(Handle);
+	if (ItemData == nullptr) return;
+
+	// Already loaded when coming from the streaming callback, this only blocks without the subsystem
+	UClass* ItemClass = ItemData->ItemActor.LoadSynchronous();
+
+	if (ItemClass == nullptr) return;
+
+	// Comes back hidden and attached to CarryItemPoint
+	AActor* SpawnItem = ItemActorPool->Acquire(ItemClass);
+
+	if (SpawnItem != nullptr)
+	{
+		EquipmentInventory[Slot].SpawnedItem = SpawnItem;
+
+		SetInventoryItemVisible(Slot, bHasItemOnHands && (IndexItemOnHands == Slot));
+	}
+}
+
+void ARPGPluginCharacter::RequestItemIcon(FName ItemID)
+{
+	const FItem* ItemData = GetItemDefinition(ResolveItemHandle(ItemID));
+
+	if ((ItemData == nullptr) || ItemData->ItemIcon.IsNull()) return;
+
+	UAssetStreamingSubsystem* AssetStreaming = GetGameInstance()->GetSubsystem<UAssetStreamingSubsystem>();
+
+	if ((ItemData->ItemIcon.Get() != nullptr) || (AssetStreaming == nullptr))
+	{
+		OnItemIconStreamed(ItemID);
+		return;
+	}
+
+	AssetStreaming->RequestAsset(ItemData->ItemIcon.ToSoftObjectPath(), FStreamableDelegate::CreateUObject(this, &ARPGPluginCharacter::OnItemIconStreamed, ItemID));
+}
+
+void ARPGPluginCharacter::OnItemIconStreamed(FName ItemID)
+{
+	const FItem* ItemData = GetItemDefinition(ResolveItemHandle(ItemID));
+
+	if (ItemData != nullptr)
+	{
+		OnItemIconLoaded(ItemID, ItemData->ItemIcon.LoadSynchronous());
+	}
+}
+
+void ARPGPluginCharacter::AddItem(FName ItemID)
 {
+	const FItemHandle Handle = ResolveItemHandle(ItemID);
+
 	// Find the item on the inventory
-	int32 ItemIndexToRemove = -1;
-	for (int i = 0; i < EquipmentInventory.Num(); i++)
+	const int32 ExistingSlot = FindInventorySlot(Handle);
+
+	if (ExistingSlot != INDEX_NONE)
 	{
-		if (EquipmentInventory[i].ItemID == ItemID)
+		EquipmentInventory[ExistingSlot].Quantity += 1;
+		MarkItemJournalDirty(Handle);
+
+		if (!bHasItemOnHands)
 		{
-			EquipmentInventory[i].Quantity -= 1;
+			IndexItemOnHands = ExistingSlot;
+			ItemIDOnHands = ItemID;
+			bHasItemOnHands = true;
 
-			if (EquipmentInventory[i].Quantity <= 0) // No more units
-			{
-				ItemIndexToRemove = i;
+			SetInventoryItemVisible(ExistingSlot, true);
 
-				// Remove item from hands
-				if (bHasItemOnHands && (ItemIDOnHands == ItemID))
-				{
-					IndexItemOnHands = -1;
-					bHasItemOnHands = false;
-					ItemIDOnHands = "";
-
-					Animator->SetAlphaRightArm(false);
-					Animator->SetAlphaLeftArm(false);
-				}
-			}
-			else if (RemoveItemFromHands) // If we hare more units, we hide it from hands
-			{
-				FreeHands();
-			}
+			Animator->SetAlphaRightArm(true);
+			Animator->SetAlphaLeftArm(true);
+		}
 
-			break;
+		if (UQuestObjectiveSubsystem* QuestObjectives = GetQuestObjectives())
+		{
+			QuestObjectives->NotifyItemCollected(this, ItemID);
 		}
+
+		MarkInventorySlotsDirty(ExistingSlot, 1);
+		return;
 	}
 
-	// If we remove all units from the item, we remove it from the list
-	if (ItemIndexToRemove >= 0)
+	if (EquipmentInventory.Num() == TotalEquipmentSlots)
 	{
-		EquipmentInventory[ItemIndexToRemove].SpawnedItem->Destroy();
-		EquipmentInventory.RemoveAt(ItemIndexToRemove);
+		UE_LOG(LogTemp, Warning, TEXT("[AHowToCharacter::AddItem] EquipmentInventory full: %d / %d "), EquipmentInventory.Num(), TotalEquipmentSlots);
+		return;
 	}
 
-	OnRefreshInventory();
+	// Find the item on the item table to get the information
+	const FItem* ItemData = GetItemDefinition(Handle);
 
+	if ((ItemData != nullptr) && !ItemData->ItemActor.IsNull())
+	{
+		// Add the item to the list of elements, its actor is spawned once the class is streamed in
+		FInventoryItem NewItem;
+		NewItem.Definition = Handle;
+		NewItem.Quantity = 1;
+
+		EquipmentInventory.Add(NewItem);
+		MarkInventorySlotsDirty(EquipmentInventory.Num() - 1, 1);
+		MarkItemJournalDirty(Handle);
+
+		// Nothing on hands, we add this item on hands
+		if (!bHasItemOnHands)
+		{
+			Animator->SetAlphaRightArm(true);
+			Animator->SetAlphaLeftArm(true);
+
+			// THe index is the last one on the list
+			IndexItemOnHands = EquipmentInventory.Num() - 1;
+			ItemIDOnHands = ItemID;
+			bHasItemOnHands = true;
+		}
+
+		if (ShouldMaterializeSlot(EquipmentInventory.Num() - 1))
+		{
+			RequestItemActor(Handle);
+		}
+
+		if (UQuestObjectiveSubsystem* QuestObjectives = GetQuestObjectives())
+		{
+			QuestObjectives->NotifyItemCollected(this, ItemID);
+		}
+	}
+}
+
+
+void ARPGPluginCharacter::RemoveItem(FName ItemID, bool RemoveItemFromHands)
+{
+	// Find the item on the inventory
+	const int32 Slot = FindInventorySlot(ResolveItemHandle(ItemID));
+
+	if (Slot != INDEX_NONE)
+	{
+		EquipmentInventory[Slot].Quantity -= 1;
+		MarkInventorySlotsDirty(Slot, 1);
+		MarkItemJournalDirty(EquipmentInventory[Slot].Definition);
+
+		if (EquipmentInventory[Slot].Quantity <= 0) // No more units
+		{
+			// Remove item from hands
+			if (bHasItemOnHands && (ItemIDOnHands == ItemID))
+			{
+				IndexItemOnHands = -1;
+				bHasItemOnHands = false;
+				ItemIDOnHands = "";
+
+				Animator->SetAlphaRightArm(false);
+				Animator->SetAlphaLeftArm(false);
+			}
+
+			// We remove all units from the item, we remove it from the list
+			// Every slot after this one moves down
+			MarkInventorySlotsDirty(Slot, EquipmentInventory.Num() - Slot);
+
+			ItemActorPool->Release(EquipmentInventory[Slot].SpawnedItem);
+			EquipmentInventory.RemoveAt(Slot);
+
+			// The item on hands moved down one slot
+			if (bHasItemOnHands && (IndexItemOnHands > Slot))
+			{
+				IndexItemOnHands -= 1;
+			}
+		}
+		else if (RemoveItemFromHands) // If we hare more units, we hide it from hands
+		{
+			FreeHands();
+		}
+	}
 }
 
 bool ARPGPluginCharacter::HasFreeInventorySlots()
@@ -613,11 +1227,12 @@ void ARPGPluginCharacter::SwitchItem()
 
 	if (!bHasItemOnHands) // No items on hands
 	{
+		// Held state first: with the class already loaded the actor is materialized right away, and only if the slot is held
 		IndexItemOnHands = 0;
-		EquipmentInventory[IndexItemOnHands].SpawnedItem->SetActorHiddenInGame(false);
-
 		bHasItemOnHands = true;
-		ItemIDOnHands = EquipmentInventory[IndexItemOnHands].ItemID;
+		ItemIDOnHands = GetInventoryItemID(IndexItemOnHands);
+
+		SetInventoryItemVisible(IndexItemOnHands, true);
 
 		Animator->SetAlphaRightArm(true);
 		Animator->SetAlphaLeftArm(true);
@@ -629,15 +1244,15 @@ void ARPGPluginCharacter::SwitchItem()
 	if (EquipmentInventory.Num() > 1)
 	{
 		// Hide the current one
-		EquipmentInventory[IndexItemOnHands].SpawnedItem->SetActorHiddenInGame(true);
+		SetInventoryItemVisible(IndexItemOnHands, false);
 
 		IndexItemOnHands += 1;
 		if (IndexItemOnHands >= EquipmentInventory.Num()) // Last item on the inventory
 		{
 			IndexItemOnHands = 0;
 		}
-		EquipmentInventory[IndexItemOnHands].SpawnedItem->SetActorHiddenInGame(false);
-		ItemIDOnHands = EquipmentInventory[IndexItemOnHands].ItemID;
+		ItemIDOnHands = GetInventoryItemID(IndexItemOnHands);
+		SetInventoryItemVisible(IndexItemOnHands, true);
 	}
 }
 
@@ -645,7 +1260,7 @@ void ARPGPluginCharacter::FreeHands()
 {
 	if (bHasItemOnHands && (IndexItemOnHands >= 0) && (IndexItemOnHands < EquipmentInventory.Num()))
 	{
-		EquipmentInventory[IndexItemOnHands].SpawnedItem->SetActorHiddenInGame(true);
+		SetInventoryItemVisible(IndexItemOnHands, false);
 	}
 
 	IndexItemOnHands = -1;
@@ -656,6 +1271,401 @@ void ARPGPluginCharacter::FreeHands()
 	Animator->SetAlphaLeftArm(false);
 }
 
-//// Inventory ///////
+void ARPGPluginCharacter::SaveInventory(TArray<FInventorySaveItem>& OutItems) const
+{
+	OutItems.Reset(EquipmentInventory.Num());
+
+	for (int i = 0; i < EquipmentInventory.Num(); i++)
+	{
+		FInventorySaveItem& SavedItem = OutItems.AddDefaulted_GetRef();
+		SavedItem.ItemID = GetInventoryItemID(i);
+		SavedItem.Quantity = EquipmentInventory[i].Quantity;
+		SavedItem.InstanceData = EquipmentInventory[i].InstanceData;
+	}
+}
 
+void ARPGPluginCharacter::RestoreInventory(const TArray<FInventorySaveItem>& SavedItems)
+{
+	if (bHasItemOnHands)
+	{
+		FreeHands();
+	}
+
+	for (FInventoryItem& Item : EquipmentInventory)
+	{
+		ItemActorPool->Release(Item.SpawnedItem);
+	}
+
+	const int32 PreviousNum = EquipmentInventory.Num();
+	EquipmentInventory.Reset(SavedItems.Num());
+
+	for (const FInventorySaveItem& SavedItem : SavedItems)
+	{
+		const FItemHandle Handle = ResolveItemHandle(SavedItem.ItemID);
+
+		// Items removed from the item table are dropped
+		if (!Handle.IsValid() || (SavedItem.Quantity <= 0) || (EquipmentInventory.Num() >= TotalEquipmentSlots)) continue;
+
+		FInventoryItem& Item = EquipmentInventory.AddDefaulted_GetRef();
+		Item.Definition = Handle;
+		Item.Quantity = SavedItem.Quantity;
+		Item.InstanceData = SavedItem.InstanceData;
+
+		if (ShouldMaterializeSlot(EquipmentInventory.Num() - 1))
+		{
+			RequestItemActor(Handle);
+		}
+	}
+
+	MarkInventorySlotsDirty(0, FMath::Max(PreviousNum, EquipmentInventory.Num()));
+
+	// This is the saved state, nothing to journal
+	JournalDirtyItems.Init(false, JournalDirtyItems.Num());
+}
+
+void ARPGPluginCharacter::MarkItemJournalDirty(FItemHandle Handle)
+{
+	if (!Handle.IsValid()) return;
 
+	if (JournalDirtyItems.Num() <= Handle.Index)
+	{
+		JournalDirtyItems.Add(false, Handle.Index + 1 - JournalDirtyItems.Num());
+	}
+
+	JournalDirtyItems[Handle.Index] = true;
+}
+
+void ARPGPluginCharacter::GatherJournalRecords(TArray<FSaveJournalRecord>& OutRecords)
+{
+	TArray<FQuestItem> DirtyQuests;
+	QuestState.ConsumeDirtyQuests(DirtyQuests);
+
+	for (const FQuestItem& Quest : DirtyQuests)
+	{
+		OutRecords.Add(FSaveJournalRecord::MakeQuest(Quest));
+	}
+
+	for (TConstSetBitIterator<> It(JournalDirtyItems); It; ++It)
+	{
+		const FItemHandle Handle(It.GetIndex());
+		const FItem* ItemData = GetItemDefinition(Handle);
+
+		if (ItemData == nullptr) continue;
+
+		// Quantity 0 removes the item from the save
+		const int32 Slot = FindInventorySlot(Handle);
+		const int32 Quantity = (Slot != INDEX_NONE) ? EquipmentInventory[Slot].Quantity : 0;
+		const int32 InstanceData = (Slot != INDEX_NONE) ? EquipmentInventory[Slot].InstanceData : 0;
+
+		OutRecords.Add(FSaveJournalRecord::MakeInventory(ItemData->ItemID, Quantity, InstanceData));
+	}
+
+	JournalDirtyItems.Init(false, JournalDirtyItems.Num());
+
+	// Collected items, completed chests...
+	if (UWorldStateSubsystem* WorldState = GetGameInstance()->GetSubsystem<UWorldStateSubsystem>())
+	{
+		WorldState->ConsumeDirty(OutRecords);
+	}
+}
+
+bool ARPGPluginCharacter::AddItemQuantity(FName ItemID, int32 Quantity)
+{
+	FItemStack Stack;
+	Stack.ItemID = ItemID;
+	Stack.Quantity = Quantity;
+
+	return AddItems({ Stack });
+}
+
+bool ARPGPluginCharacter::AddItems(const TArray<FItemStack>& Items)
+{
+	TArray<FInventoryStackPlan> Plan;
+	int32 NewSlots = 0;
+
+	if (!PlanItemStacks(Items, true, Plan, NewSlots)) return false;
+
+	ApplyAddPlan(Plan, NewSlots);
+	return true;
+}
+
+bool ARPGPluginCharacter::RemoveItems(const TArray<FItemStack>& Items)
+{
+	TArray<FInventoryStackPlan> Plan;
+	int32 NewSlots = 0;
+
+	if (!PlanItemStacks(Items, false, Plan, NewSlots)) return false;
+
+	ApplyRemovePlan(Plan);
+	return true;
+}
+
+bool ARPGPluginCharacter::MoveItemsTo(ARPGPluginCharacter* Target, const TArray<FItemStack>& Items)
+{
+	if ((Target == nullptr) || (Target == this)) return false;
+
+	TArray<FInventoryStackPlan> RemovePlan;
+	TArray<FInventoryStackPlan> AddPlan;
+	int32 NewSlots = 0;
+
+	// Both sides are validated before touching any of them
+	if (!PlanItemStacks(Items, false, RemovePlan, NewSlots)) return false;
+	if (!Target->PlanItemStacks(Items, true, AddPlan, NewSlots)) return false;
+
+	ApplyRemovePlan(RemovePlan);
+	Target->ApplyAddPlan(AddPlan, NewSlots);
+	return true;
+}
+
+bool ARPGPluginCharacter::PlanItemStacks(const TArray<FItemStack>& Items, bool bAdding, TArray<FInventoryStackPlan>& OutPlan, int32& OutNewSlots) const
+{
+	OutPlan.Reset(Items.Num());
+	OutNewSlots = 0;
+
+	TMap<int32, int32, TInlineSetAllocator<16>> HandleToPlan;
+
+	for (const FItemStack& Stack : Items)
+	{
+		const FItemHandle Handle = ResolveItemHandle(Stack.ItemID);
+
+		if (!Handle.IsValid() || (Stack.Quantity <= 0))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("[ARPGPluginCharacter::PlanItemStacks] Invalid item stack: %s x %d"), *Stack.ItemID.ToString(), Stack.Quantity);
+			return false;
+		}
+
+		if (const int32* PlanIndex = HandleToPlan.Find(Handle.Index))
+		{
+			OutPlan[*PlanIndex].Quantity += Stack.Quantity;
+			continue;
+		}
+
+		const int32 Slot = FindInventorySlot(Handle);
+
+		if (Slot == INDEX_NONE)
+		{
+			// Nothing to remove
+			if (!bAdding) return false;
+
+			// Same rule as AddItem, items without actor can't be held
+			const FItem* ItemData = GetItemDefinition(Handle);
+			if ((ItemData == nullptr) || ItemData->ItemActor.IsNull()) return false;
+
+			OutNewSlots++;
+		}
+
+		HandleToPlan.Add(Handle.Index, OutPlan.Num());
+		OutPlan.Add({ Handle, Stack.ItemID, Stack.Quantity, Slot });
+	}
+
+	if (bAdding)
+	{
+		if (EquipmentInventory.Num() + OutNewSlots > TotalEquipmentSlots)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("[ARPGPluginCharacter::PlanItemStacks] EquipmentInventory full: %d + %d / %d "), EquipmentInventory.Num(), OutNewSlots, TotalEquipmentSlots);
+			return false;
+		}
+	}
+	else
+	{
+		for (const FInventoryStackPlan& Stack : OutPlan)
+		{
+			if (EquipmentInventory[Stack.Slot].Quantity < Stack.Quantity) return false;
+		}
+	}
+
+	return true;
+}
+
+void ARPGPluginCharacter::ApplyAddPlan(const TArray<FInventoryStackPlan>& Plan, int32 NewSlots)
+{
+	BeginInventoryBatch();
+
+	EquipmentInventory.Reserve(EquipmentInventory.Num() + NewSlots);
+
+	UQuestObjectiveSubsystem* QuestObjectives = GetQuestObjectives();
+
+	for (const FInventoryStackPlan& Stack : Plan)
+	{
+		int32 Slot = Stack.Slot;
+		const bool bNewSlot = (Slot == INDEX_NONE);
+
+		if (bNewSlot)
+		{
+			FInventoryItem& NewItem = EquipmentInventory.AddDefaulted_GetRef();
+			NewItem.Definition = Stack.Handle;
+			NewItem.Quantity = Stack.Quantity;
+
+			Slot = EquipmentInventory.Num() - 1;
+		}
+		else
+		{
+			EquipmentInventory[Slot].Quantity += Stack.Quantity;
+		}
+
+		MarkItemJournalDirty(Stack.Handle);
+
+		// Nothing on hands, the first item goes on hands
+		if (!bHasItemOnHands)
+		{
+			IndexItemOnHands = Slot;
+			ItemIDOnHands = Stack.ItemID;
+			bHasItemOnHands = true;
+
+			Animator->SetAlphaRightArm(true);
+			Animator->SetAlphaLeftArm(true);
+
+			if (!bNewSlot)
+			{
+				SetInventoryItemVisible(Slot, true);
+			}
+		}
+
+		if (bNewSlot && ShouldMaterializeSlot(Slot))
+		{
+			RequestItemActor(Stack.Handle);
+		}
+
+		MarkInventorySlotsDirty(Slot, 1);
+
+		if (QuestObjectives != nullptr)
+		{
+			QuestObjectives->NotifyItemCollected(this, Stack.ItemID, Stack.Quantity);
+		}
+	}
+
+	EndInventoryBatch();
+}
+
+void ARPGPluginCharacter::ApplyRemovePlan(const TArray<FInventoryStackPlan>& Plan)
+{
+	BeginInventoryBatch();
+
+	int32 FirstEmptySlot = INDEX_NONE;
+
+	for (const FInventoryStackPlan& Stack : Plan)
+	{
+		FInventoryItem& Item = EquipmentInventory[Stack.Slot];
+		Item.Quantity -= Stack.Quantity;
+
+		MarkInventorySlotsDirty(Stack.Slot, 1);
+		MarkItemJournalDirty(Stack.Handle);
+
+		if (Item.Quantity > 0) continue;
+
+		// Remove item from hands
+		if (bHasItemOnHands && (IndexItemOnHands == Stack.Slot))
+		{
+			IndexItemOnHands = -1;
+			bHasItemOnHands = false;
+			ItemIDOnHands = "";
+
+			Animator->SetAlphaRightArm(false);
+			Animator->SetAlphaLeftArm(false);
+		}
+
+		ItemActorPool->Release(Item.SpawnedItem);
+		Item.SpawnedItem = nullptr;
+
+		FirstEmptySlot = (FirstEmptySlot == INDEX_NONE) ? Stack.Slot : FMath::Min(FirstEmptySlot, Stack.Slot);
+	}
+
+	// Compact the empty slots in a single pass
+	if (FirstEmptySlot != INDEX_NONE)
+	{
+		MarkInventorySlotsDirty(FirstEmptySlot, EquipmentInventory.Num() - FirstEmptySlot);
+
+		if (bHasItemOnHands)
+		{
+			int32 EmptyBeforeHands = 0;
+			for (int i = FirstEmptySlot; i < IndexItemOnHands; i++)
+			{
+				if (EquipmentInventory[i].Quantity <= 0)
+				{
+					EmptyBeforeHands++;
+				}
+			}
+
+			IndexItemOnHands -= EmptyBeforeHands;
+		}
+
+		EquipmentInventory.RemoveAll([](const FInventoryItem& Item) { return Item.Quantity <= 0; });
+	}
+
+	EndInventoryBatch();
+}
+
+void ARPGPluginCharacter::EndInventoryBatch()
+{
+	InventoryBatchDepth--;
+
+	if ((InventoryBatchDepth == 0) && bSynchronousInventoryRefresh)
+	{
+		FlushInventoryRefresh();
+	}
+}
+
+void ARPGPluginCharacter::MarkInventorySlotsDirty(int32 FirstSlot, int32 NumSlots)
+{
+	if (NumSlots > 0)
+	{
+		const int32 EndSlot = FirstSlot + NumSlots;
+		if (DirtyInventorySlots.Num() < EndSlot)
+		{
+			DirtyInventorySlots.Add(false, EndSlot - DirtyInventorySlots.Num());
+		}
+
+		DirtyInventorySlots.SetRange(FirstSlot, NumSlots, true);
+	}
+
+	bInventoryRefreshPending = true;
+
+	if (bSynchronousInventoryRefresh)
+	{
+		if (InventoryBatchDepth == 0)
+		{
+			FlushInventoryRefresh();
+		}
+		return;
+	}
+
+	// One refresh at the end of the frame, whatever the number of changes
+	if (!InventoryRefreshHandle.IsValid())
+	{
+		InventoryRefreshHandle = FWorldDelegates::OnWorldPostActorTick.AddUObject(this, &ARPGPluginCharacter::OnWorldPostActorTick);
+	}
+}
+
+void ARPGPluginCharacter::OnWorldPostActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds)
+{
+	if (World == GetWorld())
+	{
+		FlushInventoryRefresh();
+	}
+}
+
+void ARPGPluginCharacter::FlushInventoryRefresh()
+{
+	if (InventoryRefreshHandle.IsValid())
+	{
+		FWorldDelegates::OnWorldPostActorTick.Remove(InventoryRefreshHandle);
+		InventoryRefreshHandle.Reset();
+	}
+
+	if (!bInventoryRefreshPending) return;
+
+	bInventoryRefreshPending = false;
+
+	TArray<int32> ChangedSlots;
+	for (TConstSetBitIterator<> It(DirtyInventorySlots); It; ++It)
+	{
+		ChangedSlots.Add(It.GetIndex());
+	}
+
+	DirtyInventorySlots.Init(false, DirtyInventorySlots.Num());
+
+	OnInventorySlotsChanged(ChangedSlots);
+	OnRefreshInventory();
+}
+
+//// Inventory ///////
@@ -7,8 +7,14 @@
 #include "DefaultWeapon.h"
 #include "ItemData.h"
 #include "Interactable.h"
+#include "QuestStateStore.h"
 #include "RPGPluginCharacter.generated.h"
 
+// Native quest log changes, so listeners only pay for what changed
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnQuestAddedDelegate, FName /* QuestID */);
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnQuestCompletedDelegate, FName /* QuestID */);
+DECLARE_MULTICAST_DELEGATE_TwoParams(FOnQuestProgressDelegate, FName /* QuestID */, int32 /* Progress */);
+
 UCLASS(config = Game)
 class ARPGPluginCharacter : public ACharacter
 {
@@ -25,6 +31,10 @@ class ARPGPluginCharacter : public ACharacter
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, meta = (AllowPrivateAccess = "true"))
 		USceneComponent* CarryItemPoint;
 
+	/** Recycles the actors of the items held on hands */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Inventory", meta = (AllowPrivateAccess = "true"))
+		class UItemActorPoolComponent* ItemActorPool;
+
 
 public:
 	ARPGPluginCharacter();
@@ -49,7 +59,8 @@ protected:
 	UPROPERTY(BlueprintReadOnly, Category = "Player")
 		class UComplexAnimInstance* Animator = nullptr;
 
-	TArray<FQuestItem> QuestList;
+	// Accepted and completed quests, indexed by the quest position on the quest database
+	FQuestStateStore QuestState;
 
 	//Allows the character to start sprinting
 	void Sprint();
@@ -60,8 +71,19 @@ protected:
 	//Allows the character to punch
 	void Punch();
 
+	// Queued and resolved with the other hits of the frame, see UDamageQueueSubsystem
 	UFUNCTION(BlueprintCallable)
-		void TakeDamage(float _damageAmount);
+		void TakeDamage(float _damageAmount, AActor* _source = nullptr);
+
+	// Applies the summed damage of a frame, armor absorbs ArmoredDamage first. Returns true if it killed the character
+	bool ResolveDamage(float ArmoredDamage, float PiercingDamage);
+
+	// Once per frame the character was hit, with the damage of all the hits
+	UFUNCTION(BlueprintImplementableEvent, BlueprintCallable, Category = "Events")
+		void OnDamageTaken(float Damage);
+
+	UFUNCTION(BlueprintImplementableEvent, BlueprintCallable, Category = "Events")
+		void OnDied();
 
 	UFUNCTION(BlueprintCallable)
 		void Heal(float _healAmount);
@@ -107,12 +129,24 @@ protected:
 
 protected:
 	void BeginPlay();
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	class UQuestObjectiveSubsystem* GetQuestObjectives() const;
 	// APawn interface
 	virtual void SetupPlayerInputComponent(class UInputComponent* PlayerInputComponent) override;
 	// End of APawn interface
 
 	void UpdateAndShowQuestList();
 
+	// Restores quests and inventory from the save state kept by the game instance
+	void ApplySaveGame(class UMainSaveGame* SaveGame);
+
+	// Replaces the quest log and listens again for the objectives of the quests still running
+	void RestoreQuests(const TArray<FQuestItem>& SavedQuests);
+
+	FDelegateHandle SaveGameLoadedHandle;
+
 	//Determines when the character is sprinting
 	bool isSprinting;
 
@@ -167,6 +201,25 @@ protected:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Stats")
 		float attackSpeed;
 
+	//Damage of a punch without a weapon, weapons use their base damage instead
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Attack")
+		float punchDamage;
+
+	//Converts the base damage of the weapons to health points, health goes from 0 to 1
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Attack")
+		float weaponDamageScale;
+
+	//How far in front of the character a swing reaches
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Attack")
+		float meleeReach;
+
+	//Radius of the sphere swept by a swing
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Attack")
+		float meleeRadius;
+
+	// World time the next swing can start at, from attackSpeed and the weapon base speed
+	float NextSwingTime = 0.0f;
+
 public:
 	/** Returns CameraBoom subobject **/
 	FORCEINLINE class USpringArmComponent* GetCameraBoom() const { return CameraBoom; }
@@ -179,20 +232,60 @@ public:
 
 	void MarkQuestCompleted(FName QuestID);
 
+	void SetQuestProgress(FName QuestID, int32 Progress);
+
+	// True when every prerequisite quest is completed
+	bool CanAcceptQuest(FName QuestID) const;
+
+	bool AreQuestObjectivesDone(FName QuestID) const;
+
+	bool IsQuestObjectiveDone(int32 QuestIndex, int32 ObjectiveIndex) const;
+
+	// Called by UQuestObjectiveSubsystem, returns true when the objective doesn't need more events
+	bool AdvanceQuestObjective(int32 QuestIndex, int32 ObjectiveIndex, int32 Amount);
+
+	FOnQuestAddedDelegate OnQuestAddedDelegate;
+
+	FOnQuestCompletedDelegate OnQuestCompletedDelegate;
+
+	FOnQuestProgressDelegate OnQuestProgressDelegate;
+
 	UFUNCTION(BlueprintImplementableEvent, BlueprintCallable, Category = "Events")
 		void OnShowQuestInfo(FQuest Quest);
 
+	UFUNCTION(BlueprintImplementableEvent, BlueprintCallable, Category = "Events")
+		void OnShowQuestLocked(FQuest Quest);
+
+	// Streams the quest texture if needed, then calls OnShowQuestInfo
+	void ShowQuestInfo(FName QuestID);
+
 	UFUNCTION(BlueprintImplementableEvent, BlueprintCallable, Category = "Events")
 		void OnShowQuestCompleted(const FText& Message);
 
 	UFUNCTION(BlueprintImplementableEvent, BlueprintCallable, Category = "Events")
 		void OnShowUpdatedQuestList(const TArray<FText>& QuestTextList);
 
+	// When true, the quest list widget gets the changes below instead of a full OnShowUpdatedQuestList per change
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Quest")
+		bool bQuestListDeltaUpdates = false;
+
+	UFUNCTION(BlueprintImplementableEvent, BlueprintCallable, Category = "Events")
+		void OnQuestListEntryAdded(FName QuestID, const FText& QuestText);
+
+	UFUNCTION(BlueprintImplementableEvent, BlueprintCallable, Category = "Events")
+		void OnQuestListEntryRemoved(FName QuestID);
+
+	UFUNCTION(BlueprintImplementableEvent, BlueprintCallable, Category = "Events")
+		void OnQuestListEntryProgress(FName QuestID, int32 Progress);
+
 protected:
 
 	// Equipment inventory on UI and hands
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory")
-		TArray<FItem> EquipmentInventory;
+		TArray<FInventoryItem> EquipmentInventory;
+
+	// Item definitions the inventory handles point to
+	TWeakObjectPtr<const UItemData> ItemDatabase;
 
 	// Maximun slots 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory")
@@ -207,11 +300,33 @@ protected:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory")
 		FName ItemIDOnHands;
 
+	// When true only the item on hands has a spawned actor, the other slots are pure data.
+	// Switching items returns the actor to the pool and takes the new one
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Inventory")
+		bool bMaterializeOnlyHeldItem = false;
+
 public:
 	void AddItem(FName ItemID);
 
 	void RemoveItem(FName ItemID, bool RemoveItemFromHands);
 
+	//// Bulk operations, all or nothing: they validate everything first and refresh the UI once ///////
+
+	UFUNCTION(BlueprintCallable, Category = "Inventory")
+		bool AddItemQuantity(FName ItemID, int32 Quantity);
+
+	// Fails without changes if the items don't exist or there are not enough free slots
+	UFUNCTION(BlueprintCallable, Category = "Inventory")
+		bool AddItems(const TArray<FItemStack>& Items);
+
+	// Fails without changes if any item is missing or has not enough units
+	UFUNCTION(BlueprintCallable, Category = "Inventory")
+		bool RemoveItems(const TArray<FItemStack>& Items);
+
+	// Fails without changes if the items can't be removed from here or added to the target
+	UFUNCTION(BlueprintCallable, Category = "Inventory")
+		bool MoveItemsTo(ARPGPluginCharacter* Target, const TArray<FItemStack>& Items);
+
 	bool HasFreeInventorySlots();
 
 	bool HasItemOnHands(FName ItemID);
@@ -219,6 +334,102 @@ public:
 	UFUNCTION(BlueprintImplementableEvent, BlueprintCallable, Category = "Events")
 		void OnRefreshInventory();
 
+	// Called right before OnRefreshInventory with the slots changed since the last refresh.
+	// Slots at or past the inventory size were removed
+	UFUNCTION(BlueprintImplementableEvent, BlueprintCallable, Category = "Events")
+		void OnInventorySlotsChanged(const TArray<int32>& ChangedSlots);
+
+	// Sends the pending inventory refresh now instead of at the end of the frame
+	UFUNCTION(BlueprintCallable, Category = "Inventory")
+		void FlushInventoryRefresh();
+
+	// When true every inventory change refreshes the UI right away, instead of once per frame
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory")
+		bool bSynchronousInventoryRefresh = false;
+
+	// Streams the icon of the item, OnItemIconLoaded is called when it is ready
+	UFUNCTION(BlueprintCallable, Category = "Inventory")
+		void RequestItemIcon(FName ItemID);
+
+	UFUNCTION(BlueprintImplementableEvent, BlueprintCallable, Category = "Events")
+		void OnItemIconLoaded(FName ItemID, UTexture2D* ItemIcon);
+
+	// Copy of the definition of the item on the slot, for the UI
+	UFUNCTION(BlueprintCallable, Category = "Inventory")
+		bool GetInventoryItemDefinition(int32 Slot, FItem& OutItem) const;
+
+	FName GetInventoryItemID(int32 Slot) const;
+
+	FItemHandle ResolveItemHandle(FName ItemID) const;
+
+	const FItem* GetItemDefinition(FItemHandle Handle) const;
+
+	void SaveInventory(TArray<FInventorySaveItem>& OutItems) const;
+
+	void RestoreInventory(const TArray<FInventorySaveItem>& SavedItems);
+
+	// Quests and items changed since the last checkpoint
+	void GatherJournalRecords(TArray<struct FSaveJournalRecord>& OutRecords);
+
+protected:
+
+	void MarkItemJournalDirty(FItemHandle Handle);
+
+	// Per item definition, set when its quantity changed since the last checkpoint
+	TBitArray<> JournalDirtyItems;
+
+protected:
+
+	// One entry per item of a bulk operation, duplicated IDs merged
+	struct FInventoryStackPlan
+	{
+		FItemHandle Handle;
+
+		FName ItemID;
+
+		int32 Quantity;
+
+		int32 Slot; // INDEX_NONE when the item needs a new slot
+	};
+
+	// Validation pass, doesn't modify the inventory
+	bool PlanItemStacks(const TArray<FItemStack>& Items, bool bAdding, TArray<FInventoryStackPlan>& OutPlan, int32& OutNewSlots) const;
+
+	void ApplyAddPlan(const TArray<FInventoryStackPlan>& Plan, int32 NewSlots);
+
+	void ApplyRemovePlan(const TArray<FInventoryStackPlan>& Plan);
+
+	// Mutations between these calls refresh the UI once, even in synchronous mode
+	void BeginInventoryBatch() { InventoryBatchDepth++; }
+
+	void EndInventoryBatch();
+
+	int32 InventoryBatchDepth = 0;
+
+	void MarkInventorySlotsDirty(int32 FirstSlot, int32 NumSlots);
+
+	void OnWorldPostActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds);
+
+	TBitArray<> DirtyInventorySlots;
+
+	bool bInventoryRefreshPending = false;
+
+	FDelegateHandle InventoryRefreshHandle;
+
+	int32 FindInventorySlot(FItemHandle Handle) const;
+
+	void SetInventoryItemVisible(int32 Slot, bool bVisible);
+
+	bool ShouldMaterializeSlot(int32 Slot) const;
+
+	void RequestItemActor(FItemHandle Handle);
+
+	void OnItemActorLoaded(FItemHandle Handle);
+
+	void OnItemIconStreamed(FName ItemID);
+
+	void OnQuestInfoStreamed(FName QuestID);
+
 public:
 
 	void SwitchItem();
@@ -229,16 +440,58 @@ public:
 
 protected:
 
-	AActor* CurrentInteractiveActor;
+	// Interactive with the focus, the best scored of the candidates
+	TWeakObjectPtr<AActor> CurrentInteractiveActor;
+
+	// Interactive the character is inside of. The interface is checked once, when it is added
+	struct FInteractionCandidate
+	{
+		TWeakObjectPtr<AActor> Actor;
+
+		// Gets the focus hooks, null for other IInteractable actors
+		class ABasicInteractive* BasicInteractive = nullptr;
+	};
+
+	TArray<FInteractionCandidate, TInlineAllocator<4>> InteractionCandidates;
+
+	// Scores the candidates and moves the focus if another one wins
+	void UpdateInteractionFocus();
+
+	void SetInteractionFocus(const FInteractionCandidate* Candidate);
+
+	FTimerHandle InteractionFocusTimer;
+
+	// Seconds between focus updates while there are candidates
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Interaction")
+		float InteractionFocusInterval = 0.1f;
 
-	IInteractable* CurrentInteractive;
+	// Score per unit of dot product between the view direction and the direction to the candidate
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Interaction")
+		float InteractionViewWeight = 1.0f;
 
+	// Score lost per meter to the candidate
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Interaction")
+		float InteractionDistanceWeight = 0.5f;
+
+	// Bonus of the candidate with the focus, so near ties don't switch back and forth
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Interaction")
+		float InteractionFocusStickiness = 0.1f;
 
 public:
 
 	void OnEnterActor(AActor* InteractiveActor);
 
-	void OnLeaveActor();
+	void OnLeaveActor(AActor* InteractiveActor);
+
+	AActor* GetInteractionFocus() const { return CurrentInteractiveActor.Get(); }
+
+	// Runs OnInteract on the focused interactive, on behalf of this character
+	UFUNCTION(BlueprintCallable, Category = "Interaction")
+		void Interact();
+
+	// Only when the focused interactive changes. Either can be null
+	UFUNCTION(BlueprintImplementableEvent, BlueprintCallable, Category = "Events")
+		void OnInteractionFocusChanged(AActor* NewFocus, AActor* OldFocus);
 
 	//// Interactives ///////
 
@@ -266,4 +519,61 @@ public:
 
 	void TriggerCheckPoint_Implementation();
 
+	//// Checkpoint respawn ///////
+
+	// Puts the character back at the last checkpoint with the state it had there.
+	// Everything is restored in place from memory: no map reload, no disk access
+	UFUNCTION(BlueprintCallable, Category = "Game Events")
+		bool RespawnAtCheckpoint();
+
+	UFUNCTION(BlueprintPure, Category = "Game Events")
+		bool HasCheckpoint() const { return bHasCheckpoint; }
+
+	UFUNCTION(BlueprintImplementableEvent, BlueprintCallable, Category = "Events")
+		void OnRespawnedAtCheckpoint();
+
+protected:
+
+	// State of the character and the world on the last checkpoint
+	struct FCheckpointSnapshot
+	{
+		FTransform Transform;
+
+		FRotator ControlRotation;
+
+		float Health = 0.0f;
+
+		float Armor = 0.0f;
+
+		bool bHasArmor = false;
+
+		float ExperiencePoints = 0.0f;
+
+		float ExperienceToLevel = 0.0f;
+
+		int32 Level = 0;
+
+		int32 UpgradePoints = 0;
+
+		int32 Strength = 0;
+
+		int32 Dexterity = 0;
+
+		int32 Intellect = 0;
+
+		float AttackSpeed = 0.0f;
+
+		TArray<FInventorySaveItem> Inventory;
+
+		TArray<FQuestItem> Quests;
+
+		TBitArray<> WorldStateFlags;
+	};
+
+	void TakeCheckpointSnapshot();
+
+	FCheckpointSnapshot CheckpointSnapshot;
+
+	bool bHasCheckpoint = false;
+
 };
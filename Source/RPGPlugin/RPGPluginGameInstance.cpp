@@ -3,42 +3,324 @@
 
 #include "RPGPluginGameInstance.h"
 #include "Kismet/GameplayStatics.h"
+#include "Async/Async.h"
+#include "CompactSaveFormat.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/Paths.h"
+#include "WorldStateSubsystem.h"
 
 const FString URPGPluginGameInstance::UNIQUE_SAVE_SLOT = "SaveData_0";
 
+static TAutoConsoleVariable<float> CVarSaveGatherBudgetMs(
+	TEXT("rpg.Save.GatherBudgetMs"),
+	1.0f,
+	TEXT("Game thread time per frame spent packing a save snapshot, in milliseconds. 0 packs the snapshot in a single frame."),
+	ECVF_Default);
+
+
+void UMainSaveGame::SetWorldStateFlag(FName ID, bool bValue, TMap<FName, int32>& IDIndices)
+{
+	int32 Index = INDEX_NONE;
+
+	if (const int32* Existing = IDIndices.Find(ID))
+	{
+		Index = *Existing;
+	}
+	else
+	{
+		// Cleared flags don't need an entry
+		if (!bValue) return;
+
+		Index = WorldStateIDs.Add(ID);
+		IDIndices.Add(ID, Index);
+	}
+
+	const int32 Word = Index / 32;
+	if (WorldStateBits.Num() <= Word)
+	{
+		WorldStateBits.SetNumZeroed(Word + 1);
+	}
+
+	if (bValue)
+	{
+		WorldStateBits[Word] |= (1u << (Index % 32));
+	}
+	else
+	{
+		WorldStateBits[Word] &= ~(1u << (Index % 32));
+	}
+}
+
+
+void URPGPluginGameInstance::Init()
+{
+	Super::Init();
+
+	ActiveSaveSlot = UNIQUE_SAVE_SLOT;
+
+	if (bPreloadSaveGameOnInit)
+	{
+		PreloadSaveGameAsync();
+	}
+}
 
 bool URPGPluginGameInstance::IsNewGame()
 {
-	if (UGameplayStatics::DoesSaveGameExist(UNIQUE_SAVE_SLOT, 0))
+	// A load of an empty slot still counts as loaded, what matters is having a save
+	return (CurrentSaveGame == nullptr) && !UGameplayStatics::DoesSaveGameExist(ActiveSaveSlot, 0);
+}
+
+void URPGPluginGameInstance::SetActiveSaveSlot(const FString& SlotName)
+{
+	if (SlotName == ActiveSaveSlot)
 	{
-		return false;
+		return;
 	}
-	return true;
+
+	// Writes already queued keep the slot they were taken for
+	Journal.Flush();
+
+	ActiveSaveSlot = SlotName;
+	InvalidateSaveGame();
 }
 
-bool URPGPluginGameInstance::LoadGame()
+TArray<FSaveSlotMetadata> URPGPluginGameInstance::EnumerateSaveSlots() const
 {
-	CurrentSaveGame = nullptr;
+	TArray<FSaveSlotMetadata> Slots;
+
+	// Same place the generic save game system writes to
+	const FString SaveDir = FPaths::ProjectSavedDir() / TEXT("SaveGames");
 
-	USaveGame* Slot = UGameplayStatics::LoadGameFromSlot(UNIQUE_SAVE_SLOT, 0);
+	TArray<FString> Files;
+	IFileManager::Get().FindFiles(Files, *(SaveDir / TEXT("*.sav")), true, false);
 
-	if (Slot != nullptr)
+	Slots.Reserve(Files.Num());
+
+	for (const FString& File : Files)
 	{
-		CurrentSaveGame = Cast<UMainSaveGame>(Slot);
+		const FString FilePath = SaveDir / File;
 
-		if (CurrentSaveGame != nullptr)
+		FSaveSlotMetadata& Metadata = Slots.AddDefaulted_GetRef();
+		Metadata.SlotName = FPaths::GetBaseFilename(File);
+
+		// Legacy and version 1 saves have no metadata, they are listed with the file time
+		if (!FCompactSaveFormat::ReadMetadata(FilePath, Metadata) || (Metadata.SaveTime.GetTicks() == 0))
 		{
-			UE_LOG(LogTemp, Warning, TEXT("[UHowToGameInstance::LoadGame] Success loading %s"), *UNIQUE_SAVE_SLOT);
+			Metadata.DisplayName = Metadata.SlotName;
+			Metadata.SaveTime = IFileManager::Get().GetTimeStamp(*FilePath);
+		}
+	}
 
-			return true;
+	Slots.Sort([](const FSaveSlotMetadata& A, const FSaveSlotMetadata& B) { return A.SaveTime > B.SaveTime; });
+
+	return Slots;
+}
+
+bool URPGPluginGameInstance::LoadGame()
+{
+	if (bSaveGameLoaded)
+	{
+		// Bring the checkpoints taken since the load into the state handed out
+		if (CurrentSaveGame != nullptr)
+		{
+			FoldJournal();
 		}
+
+		return (CurrentSaveGame != nullptr);
+	}
+
+	// Too late for the preload, read it now. The pending async result will be ignored
+	TArray<uint8> FileData;
+	TArray<uint8> Body;
+	FSaveSlotMetadata Metadata;
+	UMainSaveGame* Slot = nullptr;
+
+	if (UGameplayStatics::LoadDataFromSlot(FileData, ActiveSaveSlot, 0))
+	{
+		const bool bIsBody = FCompactSaveFormat::Decode(FileData, Body, &Metadata);
+		Slot = ReadSaveGame(bIsBody ? Body : FileData, bIsBody, Metadata);
+	}
+
+	SetLoadedSaveGame(Slot);
+
+	if (CurrentSaveGame != nullptr)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("[UHowToGameInstance::LoadGame] Success loading %s"), *ActiveSaveSlot);
+
+		return true;
 	}
 
 	return false;
 }
 
+UMainSaveGame* URPGPluginGameInstance::GetLoadedSaveGame()
+{
+	if (!bSaveGameLoaded)
+	{
+		return nullptr;
+	}
+
+	if (CurrentSaveGame != nullptr)
+	{
+		FoldJournal();
+	}
+
+	return CurrentSaveGame;
+}
+
+void URPGPluginGameInstance::PreloadSaveGameAsync()
+{
+	if (bSaveGameLoaded || bSaveGamePreloading)
+	{
+		return;
+	}
+
+	if (!UGameplayStatics::DoesSaveGameExist(ActiveSaveSlot, 0))
+	{
+		return;
+	}
+
+	bSaveGamePreloading = true;
+
+	TWeakObjectPtr<URPGPluginGameInstance> WeakThis(this);
+	const FString SlotName = ActiveSaveSlot;
+	const uint32 LoadSerial = SaveGameLoadSerial;
+
+	// Reading and decompressing on a worker, only building the UObject is left for the game thread
+	Async(EAsyncExecution::ThreadPool, [WeakThis, SlotName, LoadSerial]()
+	{
+		FSaveBuffer Data = MakeShared<TArray<uint8>, ESPMode::ThreadSafe>();
+		FSaveSlotMetadata Metadata;
+		bool bIsBody = false;
+
+		if (UGameplayStatics::LoadDataFromSlot(*Data, SlotName, 0))
+		{
+			TArray<uint8> Body;
+			bIsBody = FCompactSaveFormat::Decode(*Data, Body, &Metadata);
+
+			if (bIsBody)
+			{
+				*Data = MoveTemp(Body);
+			}
+		}
+
+		AsyncTask(ENamedThreads::GameThread, [WeakThis, Data, bIsBody, Metadata, LoadSerial]()
+		{
+			if (URPGPluginGameInstance* GameInstance = WeakThis.Get())
+			{
+				GameInstance->OnSaveGamePreloaded(*Data, bIsBody, Metadata, LoadSerial);
+			}
+		});
+	});
+}
+
+void URPGPluginGameInstance::OnSaveGamePreloaded(const TArray<uint8>& Data, bool bIsBody, const FSaveSlotMetadata& Metadata, uint32 LoadSerial)
+{
+	bSaveGamePreloading = false;
+
+	// Loaded or invalidated while reading
+	if (bSaveGameLoaded || (LoadSerial != SaveGameLoadSerial))
+	{
+		return;
+	}
+
+	SetLoadedSaveGame(ReadSaveGame(Data, bIsBody, Metadata));
+}
+
+UMainSaveGame* URPGPluginGameInstance::ReadSaveGame(const TArray<uint8>& Data, bool bIsBody, const FSaveSlotMetadata& Metadata)
+{
+	if (bIsBody)
+	{
+		UMainSaveGame* SaveGame = NewObject<UMainSaveGame>(this);
+
+		if (FCompactSaveFormat::Unpack(Data, *SaveGame))
+		{
+			SaveGame->PlaytimeSeconds = Metadata.PlaytimeSeconds;
+			SaveGame->LevelName = Metadata.LevelName;
+			return SaveGame;
+		}
+
+		UE_LOG(LogTemp, Warning, TEXT("[URPGPluginGameInstance::ReadSaveGame] Malformed save %s"), *ActiveSaveSlot);
+		return nullptr;
+	}
+
+	if (FCompactSaveFormat::IsCompactSave(Data) || (Data.Num() == 0))
+	{
+		// Compact header but Decode failed, corrupted or from a newer version
+		return nullptr;
+	}
+
+	// Save written by SaveGameToSlot before the compact format, it is rewritten on the next save
+	UMainSaveGame* SaveGame = Cast<UMainSaveGame>(UGameplayStatics::LoadGameFromMemory(Data));
+
+	if (SaveGame != nullptr)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("[URPGPluginGameInstance::ReadSaveGame] Migrating legacy save %s"), *ActiveSaveSlot);
+		bMigrateLegacySave = true;
+	}
+
+	return SaveGame;
+}
+
+void URPGPluginGameInstance::SetLoadedSaveGame(UMainSaveGame* SaveGame)
+{
+	DetachSlicedSnapshot();
+
+	CurrentSaveGame = SaveGame;
+	bSaveGameLoaded = true;
+	SaveGameLoadSerial++;
+	PlaytimeSampleSeconds = FPlatformTime::Seconds();
+
+	// The snapshot plus the checkpoints appended after it
+	if (CurrentSaveGame != nullptr)
+	{
+		DiskSnapshotGeneration = CurrentSaveGame->JournalGeneration;
+
+		Journal.Open(ActiveSaveSlot, CurrentSaveGame->JournalGeneration);
+		Journal.Replay(*CurrentSaveGame);
+
+		GetSubsystem<UWorldStateSubsystem>()->ReadFrom(*CurrentSaveGame);
+
+		if (bMigrateLegacySave)
+		{
+			bMigrateLegacySave = false;
+			SaveGameAsync();
+		}
+	}
+
+	OnSaveGameLoaded.Broadcast(CurrentSaveGame);
+}
+
+void URPGPluginGameInstance::InvalidateSaveGame()
+{
+	DetachSlicedSnapshot();
+
+	CurrentSaveGame = nullptr;
+	bSaveGameLoaded = false;
+	SaveGameLoadSerial++;
+
+	// A compaction still writing belongs to the dropped state
+	bCompactingJournal = false;
+}
+
+bool URPGPluginGameInstance::ReloadSaveGame()
+{
+	// Don't read a file that is still being written
+	if (SaveTask.IsValid())
+	{
+		SaveTask.Wait();
+	}
+
+	InvalidateSaveGame();
+
+	return LoadGame();
+}
+
 bool URPGPluginGameInstance::CreateNewSaveGame()
 {
+	DetachSlicedSnapshot();
+
 	if (CurrentSaveGame == nullptr)
 	{
 		USaveGame* NewSaveGame = UGameplayStatics::CreateSaveGameObject(UMainSaveGame::StaticClass());
@@ -50,10 +332,23 @@ bool URPGPluginGameInstance::CreateNewSaveGame()
 	}
 	else
 	{
-		CurrentSaveGame->CreateSlot(UNIQUE_SAVE_SLOT);
+		CurrentSaveGame->CreateSlot(ActiveSaveSlot);
 	}
 
-	return UGameplayStatics::SaveGameToSlot(CurrentSaveGame, UNIQUE_SAVE_SLOT, 0);
+	// A new game is the state in memory from now on
+	bSaveGameLoaded = (CurrentSaveGame != nullptr);
+	SaveGameLoadSerial++;
+	PlaytimeSampleSeconds = FPlatformTime::Seconds();
+
+	GetSubsystem<UWorldStateSubsystem>()->Reset();
+
+	// The journal of the previous game doesn't apply anymore
+	Journal.Open(ActiveSaveSlot, 0);
+	Journal.DeleteFiles();
+	DiskSnapshotGeneration = 0;
+	bCompactingJournal = false;
+
+	return SaveGame();
 }
 
 
@@ -63,11 +358,315 @@ bool URPGPluginGameInstance::SaveGame()
 
 	if (CurrentSaveGame != nullptr)
 	{
-		return UGameplayStatics::SaveGameToSlot(CurrentSaveGame, UNIQUE_SAVE_SLOT, 0);
+		// This save is newer than anything queued, and must not race the file with the worker
+		PendingSaveData.Reset();
+		SlicedPacker.Reset();
+		SlicedSnapshot.Reset();
+		bSlicedSnapshotRequested = false;
+
+		Journal.FoldInto(*CurrentSaveGame);
+
+		if (SaveTask.IsValid())
+		{
+			SaveTask.Wait();
+		}
+
+		const bool bSuccess = WriteSnapshot(*TakeSnapshot());
+
+		// A compaction dropped while packing is covered by this save.
+		// With a write in flight OnSaveTaskFinished takes care of it
+		if (bCompactingJournal && !SaveTask.IsValid())
+		{
+			if (bSuccess)
+			{
+				DiskSnapshotGeneration = CompactionGeneration;
+			}
+
+			bCompactingJournal = false;
+		}
+
+		return bSuccess;
+	}
+
+	return false;
+
+}
+
+bool URPGPluginGameInstance::SaveGameAsync()
+{
+	if (CurrentSaveGame == nullptr)
+	{
+		return false;
+	}
+
+	if (SlicedPacker.IsValid())
+	{
+		// The snapshot being packed is older than the state asked for
+		bSlicedSnapshotRequested = true;
+		return true;
+	}
+
+	if (CVarSaveGatherBudgetMs.GetValueOnGameThread() > 0.0f)
+	{
+		BeginSlicedSnapshot();
+		return true;
+	}
+
+	// The snapshot is taken now, later changes to CurrentSaveGame don't leak into this save.
+	// The compression runs on the worker
+	QueueSnapshot(TakeSnapshot());
+
+	return true;
+}
+
+void URPGPluginGameInstance::QueueSnapshot(FSaveSnapshotPtr SaveData)
+{
+	if (SaveTask.IsValid())
+	{
+		PendingSaveData = SaveData;
+	}
+	else
+	{
+		StartSaveTask(SaveData);
+	}
+}
+
+URPGPluginGameInstance::FSaveSnapshotPtr URPGPluginGameInstance::TakeSnapshot()
+{
+	FSaveSnapshotPtr Snapshot = BeginSnapshot();
+
+	FCompactSaveFormat::Pack(*CurrentSaveGame, Snapshot->Body);
+
+	return Snapshot;
+}
+
+URPGPluginGameInstance::FSaveSnapshotPtr URPGPluginGameInstance::BeginSnapshot()
+{
+	const double Now = FPlatformTime::Seconds();
+	CurrentSaveGame->PlaytimeSeconds += Now - PlaytimeSampleSeconds;
+	PlaytimeSampleSeconds = Now;
+
+	if (GetWorld() != nullptr)
+	{
+		CurrentSaveGame->LevelName = UGameplayStatics::GetCurrentLevelName(GetWorld());
+	}
+
+	FSaveSnapshotPtr Snapshot = MakeShared<FSaveSnapshot, ESPMode::ThreadSafe>();
+	Snapshot->SlotName = ActiveSaveSlot;
+
+	FSaveSlotMetadata& Metadata = Snapshot->Metadata;
+	Metadata.SlotName = ActiveSaveSlot;
+	Metadata.DisplayName = CurrentSaveGame->SaveGameName;
+	Metadata.SaveTime = FDateTime::Now();
+	Metadata.CreationTime = CurrentSaveGame->CreationTime;
+	Metadata.LevelName = CurrentSaveGame->LevelName;
+	Metadata.PlaytimeSeconds = CurrentSaveGame->PlaytimeSeconds;
+
+	return Snapshot;
+}
+
+void URPGPluginGameInstance::BeginSlicedSnapshot()
+{
+	// Metadata and the fields outside of the sections are taken now, the sections over the next frames
+	SlicedSnapshot = BeginSnapshot();
+	SlicedPacker = MakeUnique<FCompactSavePacker>(*CurrentSaveGame, SlicedSnapshot->Body);
+
+	if (!SlicedSnapshotTicker.IsValid())
+	{
+		SlicedSnapshotTicker = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateUObject(this, &URPGPluginGameInstance::TickSlicedSnapshot));
+	}
+}
+
+bool URPGPluginGameInstance::TickSlicedSnapshot(float DeltaTime)
+{
+	if (SlicedPacker.IsValid())
+	{
+		const double BudgetSeconds = FMath::Max(CVarSaveGatherBudgetMs.GetValueOnGameThread(), 0.0f) / 1000.0;
+
+		if (SlicedPacker->Step(FPlatformTime::Seconds() + BudgetSeconds))
+		{
+			FinishSlicedSnapshot();
+		}
 	}
 
+	// A save asked for during the packing starts a new one
+	if (SlicedPacker.IsValid())
+	{
+		return true;
+	}
+
+	SlicedSnapshotTicker.Reset();
 	return false;
+}
+
+void URPGPluginGameInstance::FinishSlicedSnapshot()
+{
+	FSaveSnapshotPtr SaveData = SlicedSnapshot;
+
+	SlicedPacker.Reset();
+	SlicedSnapshot.Reset();
+
+	QueueSnapshot(SaveData);
+
+	if (bSlicedSnapshotRequested)
+	{
+		bSlicedSnapshotRequested = false;
+
+		if (CurrentSaveGame != nullptr)
+		{
+			BeginSlicedSnapshot();
+		}
+	}
+}
+
+void URPGPluginGameInstance::DetachSlicedSnapshot()
+{
+	if (SlicedPacker.IsValid())
+	{
+		SlicedPacker->Detach();
+	}
+}
+
+void URPGPluginGameInstance::FoldJournal()
+{
+	if (Journal.HasUnfoldedRecords())
+	{
+		DetachSlicedSnapshot();
+	}
+
+	Journal.FoldInto(*CurrentSaveGame);
+}
+
+bool URPGPluginGameInstance::WriteSnapshot(const FSaveSnapshot& Snapshot)
+{
+	TArray<uint8> FileData;
+	return FCompactSaveFormat::Encode(Snapshot.Body, Snapshot.Metadata, FileData) && UGameplayStatics::SaveDataToSlot(FileData, Snapshot.SlotName, 0);
+}
+
+void URPGPluginGameInstance::StartSaveTask(FSaveSnapshotPtr SaveData)
+{
+	TWeakObjectPtr<URPGPluginGameInstance> WeakThis(this);
+
+	SaveTask = Async(EAsyncExecution::ThreadPool, [WeakThis, SaveData]()
+	{
+		const bool bSuccess = WriteSnapshot(*SaveData);
+
+		AsyncTask(ENamedThreads::GameThread, [WeakThis, bSuccess, SlotName = SaveData->SlotName]()
+		{
+			if (URPGPluginGameInstance* GameInstance = WeakThis.Get())
+			{
+				GameInstance->OnSaveTaskFinished(bSuccess, SlotName);
+			}
+		});
+
+		return bSuccess;
+	});
+}
+
+void URPGPluginGameInstance::OnSaveTaskFinished(bool bSuccess, const FString& SlotName)
+{
+	// Already consumed by a blocking save or the shutdown
+	if (!SaveTask.IsValid())
+	{
+		return;
+	}
+
+	SaveTask.Reset();
+
+	UE_LOG(LogTemp, Warning, TEXT("[URPGPluginGameInstance::OnSaveTaskFinished] %s saving %s"), bSuccess ? TEXT("Success") : TEXT("Fail"), *SlotName);
+
+	if (PendingSaveData.IsValid())
+	{
+		StartSaveTask(PendingSaveData);
+		PendingSaveData.Reset();
+	}
+	else if (bCompactingJournal && !SlicedPacker.IsValid())
+	{
+		// The older journal file can be reused from now on
+		if (bSuccess)
+		{
+			DiskSnapshotGeneration = CompactionGeneration;
+		}
+
+		bCompactingJournal = false;
+	}
+
+	OnGameSaved.Broadcast(bSuccess);
+}
+
+bool URPGPluginGameInstance::AppendToJournal(TArray<FSaveJournalRecord>&& Records)
+{
+	if (CurrentSaveGame == nullptr)
+	{
+		return false;
+	}
+
+	Journal.Append(MoveTemp(Records));
+
+	if (Journal.GetSize() >= JournalCompactionSize)
+	{
+		CompactJournal();
+	}
+
+	return true;
+}
+
+void URPGPluginGameInstance::CompactJournal()
+{
+	if ((CurrentSaveGame == nullptr) || bCompactingJournal)
+	{
+		return;
+	}
+
+	FoldJournal();
+
+	// Reusing the older file is only safe once the snapshot of the current one is on disk,
+	// otherwise the snapshot is written again for the current generation
+	if (DiskSnapshotGeneration >= Journal.GetGeneration())
+	{
+		Journal.BeginGeneration(Journal.GetGeneration() + 1);
+	}
+
+	CompactionGeneration = Journal.GetGeneration();
+	CurrentSaveGame->JournalGeneration = CompactionGeneration;
+
+	bCompactingJournal = SaveGameAsync();
+}
+
+void URPGPluginGameInstance::Shutdown()
+{
+	// Don't lose the last checkpoint when quitting
+	if (SaveTask.IsValid())
+	{
+		SaveTask.Wait();
+		SaveTask.Reset();
+	}
+
+	if (SlicedSnapshotTicker.IsValid())
+	{
+		FTSTicker::GetCoreTicker().RemoveTicker(SlicedSnapshotTicker);
+		SlicedSnapshotTicker.Reset();
+	}
+
+	// Newer than the pending one
+	if (SlicedPacker.IsValid())
+	{
+		SlicedPacker->Step(TNumericLimits<double>::Max());
+		PendingSaveData = SlicedSnapshot;
+
+		SlicedPacker.Reset();
+		SlicedSnapshot.Reset();
+	}
+
+	if (PendingSaveData.IsValid())
+	{
+		WriteSnapshot(*PendingSaveData);
+		PendingSaveData.Reset();
+	}
+
+	Journal.Flush();
 
+	Super::Shutdown();
 }
 
 
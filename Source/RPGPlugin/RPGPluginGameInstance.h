@@ -5,9 +5,44 @@
 #include "CoreMinimal.h"
 #include "Engine/GameInstance.h"
 #include "GameFramework/SaveGame.h"
+#include "Async/Future.h"
+#include "Containers/Ticker.h"
 #include "ItemData.h"
+#include "SaveJournal.h"
+#include "CompactSaveFormat.h"
 #include "RPGPluginGameInstance.generated.h"
 
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnGameSavedDelegate, bool /* bSuccess */);
+
+class UMainSaveGame;
+
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnSaveGameLoadedDelegate, UMainSaveGame* /* SaveGame */);
+
+// What the load menu shows for a slot, read from the start of the file without loading the save
+USTRUCT(BlueprintType)
+struct FSaveSlotMetadata
+{
+	GENERATED_USTRUCT_BODY()
+
+		UPROPERTY(BlueprintReadOnly, Category = "Save")
+		FString SlotName;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Save")
+		FString DisplayName;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Save")
+		FDateTime SaveTime;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Save")
+		FDateTime CreationTime;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Save")
+		FString LevelName;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Save")
+		float PlaytimeSeconds = 0.0f;
+};
+
 UCLASS()
 class RPGPLUGIN_API UMainSaveGame : public USaveGame
 {
@@ -24,12 +59,49 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 		TArray<FQuestItem> QuestStatus;
 
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		TArray<FInventorySaveItem> Inventory;
+
+	// Journal files older than this are already folded into the snapshot
+	UPROPERTY()
+		int32 JournalGeneration = 0;
+
+	// Stored in the slot metadata
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		float PlaytimeSeconds = 0.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		FString LevelName;
+
+	// Level actors with persistent state, see UWorldStateSubsystem
+	UPROPERTY()
+		TArray<FName> WorldStateIDs;
+
+	// One bit per WorldStateIDs entry, packed in 32 bit words
+	UPROPERTY()
+		TArray<uint32> WorldStateBits;
+
+	bool GetWorldStateFlag(int32 Index) const
+	{
+		const int32 Word = Index / 32;
+		return WorldStateBits.IsValidIndex(Word) && ((WorldStateBits[Word] & (1u << (Index % 32))) != 0);
+	}
+
+	// IDIndices maps WorldStateIDs to their position. The caller builds it once for many changes in a row,
+	// new IDs are added to it here
+	void SetWorldStateFlag(FName ID, bool bValue, TMap<FName, int32>& IDIndices);
 
 	void CreateSlot(const FString& SlotName)
 	{
 		SaveGameName = SlotName;
 		CreationTime = FDateTime::Now();
 		QuestStatus.Empty();
+		Inventory.Empty();
+		JournalGeneration = 0;
+		PlaytimeSeconds = 0.0f;
+		LevelName.Empty();
+		WorldStateIDs.Empty();
+		WorldStateBits.Empty();
 	};
 
 };
@@ -41,25 +113,178 @@ class RPGPLUGIN_API URPGPluginGameInstance : public UGameInstance
 
 private:
 
+	// Slot used until another one is selected
 	static const FString UNIQUE_SAVE_SLOT;
 
 public:
 
+	// In memory state of the save slot, read from disk only once
 	UPROPERTY()
 		UMainSaveGame* CurrentSaveGame;
 
+	// Start reading the slot in the background as soon as the game instance exists
+	UPROPERTY(EditDefaultsOnly, Category = "Save")
+		bool bPreloadSaveGameOnInit = true;
+
+	// Once the journal grows past this many bytes it is folded into a new snapshot
+	UPROPERTY(EditDefaultsOnly, Category = "Save")
+		int32 JournalCompactionSize = 64 * 1024;
+
 public:
 
+	virtual void Init() override;
+
 	bool IsNewGame();
 
 	bool CreateNewSaveGame();
 
+	//// Slots ///////
+
+	// Following loads and saves use this slot, the state in memory of the previous one is dropped
+	UFUNCTION(BlueprintCallable, Category = "Save")
+		void SetActiveSaveSlot(const FString& SlotName);
+
+	UFUNCTION(BlueprintPure, Category = "Save")
+		FString GetActiveSaveSlot() const { return ActiveSaveSlot; }
+
+	// Every slot on disk, newest first. One directory pass, only the file headers are read
+	UFUNCTION(BlueprintCallable, Category = "Save")
+		TArray<FSaveSlotMetadata> EnumerateSaveSlots() const;
+
 public:
 
+	// Reads the slot the first time, later calls return the state already in memory
 	bool LoadGame();
 
+	UMainSaveGame* GetLoadedSaveGame();
+
+	// Reads the slot on a background thread, OnSaveGameLoaded is broadcast when done
+	void PreloadSaveGameAsync();
+
+	bool IsSaveGameLoaded() const { return bSaveGameLoaded; }
+
+	bool IsSaveGamePreloading() const { return bSaveGamePreloading; }
+
+	// Drops the state in memory, the next LoadGame reads the slot again
+	void InvalidateSaveGame();
+
+	// For when the file has changed on disk
+	bool ReloadSaveGame();
+
+	FOnSaveGameLoadedDelegate OnSaveGameLoaded;
+
+	// Blocking save, waits for any async save still writing. Writes the compact format (FCompactSaveFormat)
 	bool SaveGame();
 
+	// Snapshots CurrentSaveGame and compresses/writes it on a background thread. While a write is running
+	// only the newest snapshot is kept, older ones are dropped.
+	// With rpg.Save.GatherBudgetMs above 0 the snapshot is packed over several frames before the write
+	bool SaveGameAsync();
+
+	bool IsSaving() const { return SaveTask.IsValid(); }
+
+	// Broadcast on the game thread after every background write
+	FOnGameSavedDelegate OnGameSaved;
+
+	// Checkpoint path: only the changes are written, appended to the journal of the slot
+	bool AppendToJournal(TArray<FSaveJournalRecord>&& Records);
+
+	// Folds the journal into CurrentSaveGame and writes it as a new snapshot in the background
+	void CompactJournal();
+
+	virtual void Shutdown() override;
+
+private:
+
+	void SetLoadedSaveGame(UMainSaveGame* SaveGame);
+
+	void OnSaveGamePreloaded(const TArray<uint8>& Data, bool bIsBody, const FSaveSlotMetadata& Metadata, uint32 LoadSerial);
+
+	// Data is a compact save body, or a legacy SaveGameToSlot file when bIsBody is false
+	UMainSaveGame* ReadSaveGame(const TArray<uint8>& Data, bool bIsBody, const FSaveSlotMetadata& Metadata);
+
+	FString ActiveSaveSlot;
+
+	// Playtime is added to the save when a snapshot is taken
+	double PlaytimeSampleSeconds = 0.0;
+
+	// The loaded file was in the legacy format, rewrite it once it is loaded
+	bool bMigrateLegacySave = false;
+
+	bool bSaveGameLoaded = false;
+
+	// Bumped by every load or invalidation, stale async loads are ignored
+	uint32 SaveGameLoadSerial = 0;
+
+	bool bSaveGamePreloading = false;
+
+	typedef TSharedPtr<TArray<uint8>, ESPMode::ThreadSafe> FSaveBuffer;
+
+	// Everything the worker needs to write a save, taken on the game thread
+	struct FSaveSnapshot
+	{
+		FString SlotName;
+
+		TArray<uint8> Body;
+
+		FSaveSlotMetadata Metadata;
+	};
+
+	typedef TSharedPtr<FSaveSnapshot, ESPMode::ThreadSafe> FSaveSnapshotPtr;
+
+	FSaveSnapshotPtr TakeSnapshot();
+
+	// Snapshot with the metadata only, the body is packed by the caller
+	FSaveSnapshotPtr BeginSnapshot();
+
+	static bool WriteSnapshot(const FSaveSnapshot& Snapshot);
+
+	void StartSaveTask(FSaveSnapshotPtr SaveData);
+
+	// Written now, or after the write in flight
+	void QueueSnapshot(FSaveSnapshotPtr SaveData);
+
+	//// Time sliced snapshot ///////
+
+	void BeginSlicedSnapshot();
+
+	bool TickSlicedSnapshot(float DeltaTime);
+
+	void FinishSlicedSnapshot();
+
+	// Must be called before CurrentSaveGame is modified or replaced while a snapshot is being packed
+	void DetachSlicedSnapshot();
+
+	// Folds the journal into CurrentSaveGame
+	void FoldJournal();
+
+	FSaveSnapshotPtr SlicedSnapshot;
+
+	TUniquePtr<FCompactSavePacker> SlicedPacker;
+
+	// Another save was asked for while packing, a new snapshot is packed once this one is done
+	bool bSlicedSnapshotRequested = false;
+
+	FTSTicker::FDelegateHandle SlicedSnapshotTicker;
+
+	// SlotName is the slot of the snapshot written, the active one may have changed since
+	void OnSaveTaskFinished(bool bSuccess, const FString& SlotName);
+
+	// Write in flight
+	TFuture<bool> SaveTask;
+
+	// Newest snapshot waiting for the write in flight
+	FSaveSnapshotPtr PendingSaveData;
+
+	FSaveJournal Journal;
+
+	// Generation of the last snapshot known to be on disk
+	int32 DiskSnapshotGeneration = 0;
+
+	// Generation of the snapshot being written by the compaction
+	int32 CompactionGeneration = 0;
+
+	bool bCompactingJournal = false;
 
 };
 
@@ -21,6 +21,17 @@ ARPGPluginGameMode::ARPGPluginGameMode()
 void ARPGPluginGameMode::BeginPlay()
 {
 	Super::BeginPlay();
+
+	// Build the lookup tables once, the data assets rebuild them if they are edited
+	if (QuestDatabase != nullptr)
+	{
+		QuestDatabase->BuildIndex();
+	}
+
+	if (ItemDatabase != nullptr)
+	{
+		ItemDatabase->BuildIndex();
+	}
 }
 
 
@@ -28,42 +39,61 @@ void ARPGPluginGameMode::BeginPlay()
 
 FItem ARPGPluginGameMode::FindItem_Implementation(FName ItemID, bool& Success)
 {
-	Success = false;
+	const FItem* Item = FindItemData(ItemID);
 
-	FItem Item;
-	if (ItemDatabase == nullptr) { return Item; }
+	Success = (Item != nullptr);
 
-	for (int i = 0; i < ItemDatabase->Data.Num(); i++)
-	{
-		if (ItemDatabase->Data[i].ItemID == ItemID)
-		{
-			Success = true;
-			return ItemDatabase->Data[i];
+	return Success ? *Item : FItem();
+}
 
-		}
-	}
+const FItem* ARPGPluginGameMode::FindItemData(FName ItemID) const
+{
+	if (ItemDatabase == nullptr) { return nullptr; }
 
-	return Item;
+	return ItemDatabase->FindItem(ItemID);
+}
+
+int32 ARPGPluginGameMode::FindItemIndex(FName ItemID) const
+{
+	if (ItemDatabase == nullptr) { return INDEX_NONE; }
+
+	return ItemDatabase->FindItemIndex(ItemID);
+}
+
+const FItem* ARPGPluginGameMode::GetItemByIndex(int32 ItemIndex) const
+{
+	if (ItemDatabase == nullptr) { return nullptr; }
+
+	return ItemDatabase->GetItemByIndex(ItemIndex);
 }
 
 
 FQuest ARPGPluginGameMode::FindQuest_Implementation(FName QuestID, bool& Success)
 {
-	Success = false;
+	const FQuest* Quest = FindQuestData(QuestID);
 
-	FQuest Quest;
-	if (QuestDatabase == nullptr) { return Quest; }
+	Success = (Quest != nullptr);
 
-	for (int i = 0; i < QuestDatabase->QuestData.Num(); i++)
-	{
-		if (QuestDatabase->QuestData[i].QuestID == QuestID)
-		{
-			Success = true;
-			return QuestDatabase->QuestData[i];
+	return Success ? *Quest : FQuest();
+}
 
-		}
-	}
+const FQuest* ARPGPluginGameMode::FindQuestData(FName QuestID) const
+{
+	if (QuestDatabase == nullptr) { return nullptr; }
 
-	return Quest;
+	return QuestDatabase->FindQuest(QuestID);
 }
 
+int32 ARPGPluginGameMode::FindQuestIndex(FName QuestID) const
+{
+	if (QuestDatabase == nullptr) { return INDEX_NONE; }
+
+	return QuestDatabase->FindQuestIndex(QuestID);
+}
+
+const FQuest* ARPGPluginGameMode::GetQuestByIndex(int32 QuestIndex) const
+{
+	if (QuestDatabase == nullptr) { return nullptr; }
+
+	return QuestDatabase->GetQuestByIndex(QuestIndex);
+}
@@ -33,6 +33,15 @@ public:
 
 	FQuest FindQuest_Implementation(FName QuestID, bool& Success);
 
+	// Native lookups, no copies. The pointers stay valid while the quest database is unchanged
+	const FQuest* FindQuestData(FName QuestID) const;
+
+	int32 FindQuestIndex(FName QuestID) const;
+
+	const FQuest* GetQuestByIndex(int32 QuestIndex) const;
+
+	FORCEINLINE const UQuestData* GetQuestDatabase() const { return QuestDatabase; }
+
 
 	///////////////////////// Inventory ////////////////////////////////
 protected:
@@ -47,6 +56,15 @@ public:
 
 	FItem FindItem_Implementation(FName ItemID, bool& Success);
 
+	// Native lookups, no copies. The pointers stay valid while the item database is unchanged
+	const FItem* FindItemData(FName ItemID) const;
+
+	int32 FindItemIndex(FName ItemID) const;
+
+	const FItem* GetItemByIndex(int32 ItemIndex) const;
+
+	FORCEINLINE const UItemData* GetItemDatabase() const { return ItemDatabase; }
+
 
 	///////////////////////// Inventory ////////////////////////////////
 };
@@ -0,0 +1,426 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SaveJournal.h"
+#include "RPGPluginGameInstance.h"
+#include "Async/Async.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+namespace SaveJournal
+{
+	static const uint32 Magic = 0x4A475052; // "RPGJ"
+	static const uint32 Version = 1;
+
+	// Magic, version, generation
+	static const int64 HeaderSize = sizeof(uint32) * 2 + sizeof(int32);
+}
+
+//// Records ///////
+
+FSaveJournalRecord FSaveJournalRecord::MakeQuest(const FQuestItem& InQuest)
+{
+	FSaveJournalRecord Record;
+	Record.Type = ESaveJournalRecordType::Quest;
+	Record.Quest = InQuest;
+	return Record;
+}
+
+FSaveJournalRecord FSaveJournalRecord::MakeInventory(FName ItemID, int32 Quantity, int32 InstanceData)
+{
+	FSaveJournalRecord Record;
+	Record.Type = ESaveJournalRecordType::Inventory;
+	Record.Item.ItemID = ItemID;
+	Record.Item.Quantity = Quantity;
+	Record.Item.InstanceData = InstanceData;
+	return Record;
+}
+
+FSaveJournalRecord FSaveJournalRecord::MakeWorldState(FName ID, bool bValue)
+{
+	FSaveJournalRecord Record;
+	Record.Type = ESaveJournalRecordType::WorldState;
+	Record.WorldStateID = ID;
+	Record.bWorldStateFlag = bValue;
+	return Record;
+}
+
+FArchive& operator<<(FArchive& Ar, FSaveJournalRecord& Record)
+{
+	Ar << Record.Type;
+
+	switch (Record.Type)
+	{
+	case ESaveJournalRecordType::Quest:
+		Ar << Record.Quest.QuestID;
+		Ar << Record.Quest.IsCompleted;
+		Ar << Record.Quest.Progress;
+		Ar << Record.Quest.ObjectiveProgress;
+		break;
+	case ESaveJournalRecordType::Inventory:
+		Ar << Record.Item.ItemID;
+		Ar << Record.Item.Quantity;
+		Ar << Record.Item.InstanceData;
+		break;
+	case ESaveJournalRecordType::WorldState:
+		Ar << Record.WorldStateID;
+		Ar << Record.bWorldStateFlag;
+		break;
+	default:
+		Ar.SetError();
+		break;
+	}
+
+	return Ar;
+}
+
+//// Fold ///////
+
+void FSaveJournalFold::Apply(const FSaveJournalRecord& Record)
+{
+	switch (Record.Type)
+	{
+	case ESaveJournalRecordType::Quest:
+		ApplyQuest(Record.Quest);
+		break;
+	case ESaveJournalRecordType::Inventory:
+		ApplyInventory(Record.Item);
+		break;
+	case ESaveJournalRecordType::WorldState:
+		ApplyWorldState(Record.WorldStateID, Record.bWorldStateFlag);
+		break;
+	}
+}
+
+void FSaveJournalFold::ApplyQuest(const FQuestItem& Quest)
+{
+	if (!bQuestIndicesBuilt)
+	{
+		// The first entry of an ID wins, like a search from the start
+		QuestIndices.Reserve(SaveGame.QuestStatus.Num());
+		for (int32 Index = SaveGame.QuestStatus.Num() - 1; Index >= 0; Index--)
+		{
+			QuestIndices.Add(SaveGame.QuestStatus[Index].QuestID, Index);
+		}
+
+		bQuestIndicesBuilt = true;
+	}
+
+	if (const int32* Index = QuestIndices.Find(Quest.QuestID))
+	{
+		SaveGame.QuestStatus[*Index] = Quest;
+	}
+	else
+	{
+		QuestIndices.Add(Quest.QuestID, SaveGame.QuestStatus.Add(Quest));
+	}
+}
+
+void FSaveJournalFold::ApplyInventory(const FInventorySaveItem& Item)
+{
+	if (!bItemIndicesBuilt)
+	{
+		ItemIndices.Reserve(SaveGame.Inventory.Num());
+		for (int32 Index = SaveGame.Inventory.Num() - 1; Index >= 0; Index--)
+		{
+			ItemIndices.Add(SaveGame.Inventory[Index].ItemID, Index);
+		}
+
+		bItemIndicesBuilt = true;
+	}
+
+	const int32* Index = ItemIndices.Find(Item.ItemID);
+	const bool bPresent = (Index != nullptr) && (SaveGame.Inventory[*Index].Quantity > 0);
+
+	if (Item.Quantity <= 0)
+	{
+		// Emptied in place, the positions in the map stay valid until Finish
+		if (bPresent)
+		{
+			SaveGame.Inventory[*Index].Quantity = 0;
+			bEmptiedItems = true;
+		}
+	}
+	else if (bPresent)
+	{
+		SaveGame.Inventory[*Index] = Item;
+	}
+	else
+	{
+		// Added back after a removal: at the end, like before, the emptied entry goes away on Finish
+		bEmptiedItems |= (Index != nullptr);
+		ItemIndices.Add(Item.ItemID, SaveGame.Inventory.Add(Item));
+	}
+}
+
+void FSaveJournalFold::ApplyWorldState(FName ID, bool bValue)
+{
+	if (!bWorldStateIndicesBuilt)
+	{
+		WorldStateIndices.Reserve(SaveGame.WorldStateIDs.Num());
+		for (int32 Index = SaveGame.WorldStateIDs.Num() - 1; Index >= 0; Index--)
+		{
+			WorldStateIndices.Add(SaveGame.WorldStateIDs[Index], Index);
+		}
+
+		bWorldStateIndicesBuilt = true;
+	}
+
+	SaveGame.SetWorldStateFlag(ID, bValue, WorldStateIndices);
+}
+
+void FSaveJournalFold::Finish()
+{
+	if (bEmptiedItems)
+	{
+		SaveGame.Inventory.RemoveAll([](const FInventorySaveItem& Entry) { return Entry.Quantity <= 0; });
+	}
+
+	QuestIndices.Reset();
+	ItemIndices.Reset();
+	WorldStateIndices.Reset();
+	bQuestIndicesBuilt = false;
+	bItemIndicesBuilt = false;
+	bWorldStateIndicesBuilt = false;
+	bEmptiedItems = false;
+}
+
+//// Journal ///////
+
+FSaveJournal::FSaveJournal()
+	: Writer(MakeShared<FWriter, ESPMode::ThreadSafe>())
+{
+}
+
+void FSaveJournal::Open(const FString& InSlotName, int32 SnapshotGeneration)
+{
+	SlotName = InSlotName;
+	Generation = SnapshotGeneration;
+	Size = 0;
+	Tail.Empty();
+}
+
+void FSaveJournal::Replay(UMainSaveGame& SaveGame)
+{
+	// Any write still queued has to land before reading the files back
+	Flush();
+
+	Size = ReplayFile(Generation, SaveGame);
+
+	// A compaction started but its snapshot never made it to disk, keep appending to the newer file
+	const int64 NextSize = ReplayFile(Generation + 1, SaveGame);
+
+	if (NextSize > 0)
+	{
+		Generation++;
+		Size = NextSize;
+	}
+}
+
+int64 FSaveJournal::ReplayFile(int32 InGeneration, UMainSaveGame& SaveGame)
+{
+	TArray<uint8> Data;
+
+	if (!FFileHelper::LoadFileToArray(Data, *GetJournalPath(InGeneration), FILEREAD_Silent))
+	{
+		return 0;
+	}
+
+	FMemoryReader Reader(Data);
+
+	uint32 FileMagic = 0;
+	uint32 FileVersion = 0;
+	int32 FileGeneration = INDEX_NONE;
+	Reader << FileMagic << FileVersion << FileGeneration;
+
+	if (Reader.IsError() || (FileMagic != SaveJournal::Magic) || (FileVersion != SaveJournal::Version) || (FileGeneration != InGeneration))
+	{
+		return 0;
+	}
+
+	int64 ValidSize = Reader.Tell();
+
+	FSaveJournalFold Fold(SaveGame);
+
+	// Batches are checksummed, a torn write at the end of the file stops the replay
+	while (!Reader.AtEnd())
+	{
+		uint32 BatchSize = 0;
+		uint32 BatchCrc = 0;
+		Reader << BatchSize << BatchCrc;
+
+		if (Reader.IsError() || (Reader.Tell() + BatchSize > Reader.TotalSize()))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("[FSaveJournal::ReplayFile] Truncated batch in %s"), *GetJournalPath(InGeneration));
+			break;
+		}
+
+		const uint8* BatchData = Data.GetData() + Reader.Tell();
+
+		if (FCrc::MemCrc32(BatchData, BatchSize) != BatchCrc)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("[FSaveJournal::ReplayFile] Corrupted batch in %s"), *GetJournalPath(InGeneration));
+			break;
+		}
+
+		TArray<FSaveJournalRecord> Records;
+		Reader << Records;
+
+		if (Reader.IsError())
+		{
+			break;
+		}
+
+		for (const FSaveJournalRecord& Record : Records)
+		{
+			Fold.Apply(Record);
+		}
+
+		ValidSize = Reader.Tell();
+	}
+
+	Fold.Finish();
+
+	// Cut the broken tail, or the batches appended after it would never be read
+	if (ValidSize < Data.Num())
+	{
+		FWriteOp Op;
+		Op.Path = GetJournalPath(InGeneration);
+		Op.Data.Append(Data.GetData(), ValidSize);
+		Op.bTruncate = true;
+		Enqueue(MoveTemp(Op));
+	}
+
+	return ValidSize;
+}
+
+void FSaveJournal::Append(TArray<FSaveJournalRecord>&& Records)
+{
+	if (Records.Num() == 0)
+	{
+		return;
+	}
+
+	TArray<uint8> Payload;
+	FMemoryWriter PayloadWriter(Payload);
+	PayloadWriter << Records;
+
+	uint32 BatchSize = Payload.Num();
+	uint32 BatchCrc = FCrc::MemCrc32(Payload.GetData(), Payload.Num());
+
+	FWriteOp Op;
+	Op.Path = GetJournalPath(Generation);
+
+	FMemoryWriter BatchWriter(Op.Data);
+	BatchWriter << BatchSize << BatchCrc;
+	Op.Data.Append(Payload);
+
+	// The first batch of a generation creates the file
+	if (Size == 0)
+	{
+		BeginGeneration(Generation);
+	}
+
+	Size += Op.Data.Num();
+	Enqueue(MoveTemp(Op));
+
+	Tail.Append(MoveTemp(Records));
+}
+
+void FSaveJournal::FoldInto(UMainSaveGame& SaveGame)
+{
+	FSaveJournalFold Fold(SaveGame);
+
+	for (const FSaveJournalRecord& Record : Tail)
+	{
+		Fold.Apply(Record);
+	}
+
+	Fold.Finish();
+
+	Tail.Empty();
+}
+
+void FSaveJournal::BeginGeneration(int32 NewGeneration)
+{
+	Generation = NewGeneration;
+
+	FWriteOp Op;
+	Op.Path = GetJournalPath(Generation);
+	Op.bTruncate = true;
+
+	uint32 FileMagic = SaveJournal::Magic;
+	uint32 FileVersion = SaveJournal::Version;
+	int32 FileGeneration = Generation;
+
+	FMemoryWriter HeaderWriter(Op.Data);
+	HeaderWriter << FileMagic << FileVersion << FileGeneration;
+
+	Size = SaveJournal::HeaderSize;
+	Enqueue(MoveTemp(Op));
+}
+
+void FSaveJournal::DeleteFiles()
+{
+	for (int32 Parity = 0; Parity < 2; Parity++)
+	{
+		FWriteOp Op;
+		Op.Path = GetJournalPath(Parity);
+		Op.bDelete = true;
+		Enqueue(MoveTemp(Op));
+	}
+
+	Size = 0;
+	Tail.Empty();
+}
+
+void FSaveJournal::Flush()
+{
+	Writer->Drain();
+}
+
+FString FSaveJournal::GetJournalPath(int32 InGeneration) const
+{
+	return FPaths::ProjectSavedDir() / TEXT("SaveGames") / FString::Printf(TEXT("%s.%d.journal"), *SlotName, InGeneration & 1);
+}
+
+void FSaveJournal::Enqueue(FWriteOp&& Op)
+{
+	Writer->Ops.Enqueue(MoveTemp(Op));
+
+	TSharedRef<FWriter, ESPMode::ThreadSafe> SharedWriter = Writer;
+	Async(EAsyncExecution::ThreadPool, [SharedWriter]()
+	{
+		SharedWriter->Drain();
+	});
+}
+
+void FSaveJournal::FWriter::Drain()
+{
+	// Whoever takes the lock first runs everything queued so far, the order is kept
+	FScopeLock ScopeLock(&Lock);
+
+	FWriteOp Op;
+	while (Ops.Dequeue(Op))
+	{
+		if (Op.bDelete)
+		{
+			IFileManager::Get().Delete(*Op.Path, false, false, true);
+			continue;
+		}
+
+		TUniquePtr<FArchive> File(IFileManager::Get().CreateFileWriter(*Op.Path, Op.bTruncate ? 0 : FILEWRITE_Append));
+
+		if (!File.IsValid())
+		{
+			UE_LOG(LogTemp, Warning, TEXT("[FSaveJournal::Drain] Can't write %s"), *Op.Path);
+			continue;
+		}
+
+		File->Serialize(Op.Data.GetData(), Op.Data.Num());
+		File->Close();
+	}
+}
@@ -0,0 +1,164 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Queue.h"
+#include "ItemData.h"
+
+class UMainSaveGame;
+
+enum class ESaveJournalRecordType : uint8
+{
+	Quest = 1,		// Full state of one accepted quest
+	Inventory = 2,	// Quantity of one item, 0 removes it
+	WorldState = 3,	// Flag of one level actor
+};
+
+/**
+ * One mutation of the save. Records hold absolute values, so applying one twice is harmless
+ * and a crash while compacting never corrupts the state.
+ */
+struct RPGPLUGIN_API FSaveJournalRecord
+{
+	ESaveJournalRecordType Type = ESaveJournalRecordType::Quest;
+
+	FQuestItem Quest;
+
+	FInventorySaveItem Item;
+
+	FName WorldStateID;
+
+	bool bWorldStateFlag = false;
+
+	static FSaveJournalRecord MakeQuest(const FQuestItem& InQuest);
+
+	static FSaveJournalRecord MakeInventory(FName ItemID, int32 Quantity, int32 InstanceData);
+
+	static FSaveJournalRecord MakeWorldState(FName ID, bool bValue);
+
+	friend FArchive& operator<<(FArchive& Ar, FSaveJournalRecord& Record);
+};
+
+/**
+ * Applies records to a save, many in a row. The ID to position lookups are built on first use and kept
+ * up to date, so each record costs a map lookup instead of a scan of the save.
+ * Removed inventory entries are only emptied, Finish compacts them once at the end.
+ */
+class RPGPLUGIN_API FSaveJournalFold
+{
+public:
+
+	explicit FSaveJournalFold(UMainSaveGame& InSaveGame) : SaveGame(InSaveGame) {}
+
+	void Apply(const FSaveJournalRecord& Record);
+
+	void Finish();
+
+private:
+
+	void ApplyQuest(const FQuestItem& Quest);
+
+	void ApplyInventory(const FInventorySaveItem& Item);
+
+	void ApplyWorldState(FName ID, bool bValue);
+
+	UMainSaveGame& SaveGame;
+
+	TMap<FName, int32> QuestIndices;
+
+	TMap<FName, int32> ItemIndices;
+
+	TMap<FName, int32> WorldStateIndices;
+
+	bool bQuestIndicesBuilt = false;
+
+	bool bItemIndicesBuilt = false;
+
+	bool bWorldStateIndicesBuilt = false;
+
+	bool bEmptiedItems = false;
+};
+
+/**
+ * Append-only log of save mutations, kept next to the save slot.
+ * The slot holds a snapshot tagged with a generation. Records written after it go to the journal
+ * file of the same generation, and compaction starts the next one once a new snapshot is written.
+ * The files alternate by generation parity, so the previous one survives until its snapshot is on disk.
+ * All file access runs in order on a background thread.
+ */
+class RPGPLUGIN_API FSaveJournal
+{
+public:
+
+	FSaveJournal();
+
+	// Binds the journal to a slot, the snapshot of the slot is at SnapshotGeneration
+	void Open(const FString& SlotName, int32 SnapshotGeneration);
+
+	// Applies the journal files written after the snapshot. Blocking read, done once per load
+	void Replay(UMainSaveGame& SaveGame);
+
+	// Queues the records for writing. They are kept in memory until folded into the save
+	void Append(TArray<FSaveJournalRecord>&& Records);
+
+	// Applies the records appended since the last fold
+	void FoldInto(UMainSaveGame& SaveGame);
+
+	bool HasUnfoldedRecords() const { return Tail.Num() > 0; }
+
+	// Starts an empty journal file, for after a snapshot of NewGeneration has been requested
+	void BeginGeneration(int32 NewGeneration);
+
+	// Removes the journal files of the slot, for new games
+	void DeleteFiles();
+
+	// Blocks until every queued write is on disk
+	void Flush();
+
+	int32 GetGeneration() const { return Generation; }
+
+	// Bytes written to the current journal file
+	int64 GetSize() const { return Size; }
+
+private:
+
+	FString GetJournalPath(int32 InGeneration) const;
+
+	// Returns the size of the valid part of the file, 0 if it doesn't belong to this generation
+	int64 ReplayFile(int32 InGeneration, UMainSaveGame& SaveGame);
+
+	struct FWriteOp
+	{
+		FString Path;
+
+		TArray<uint8> Data;
+
+		bool bTruncate = false;
+
+		bool bDelete = false;
+	};
+
+	// Shared with the background tasks, so they can outlive the journal
+	struct FWriter
+	{
+		TQueue<FWriteOp, EQueueMode::Spsc> Ops;
+
+		FCriticalSection Lock;
+
+		// Runs every queued operation in order
+		void Drain();
+	};
+
+	void Enqueue(FWriteOp&& Op);
+
+	TSharedRef<FWriter, ESPMode::ThreadSafe> Writer;
+
+	FString SlotName;
+
+	int32 Generation = 0;
+
+	int64 Size = 0;
+
+	TArray<FSaveJournalRecord> Tail;
+};
@@ -0,0 +1,259 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TickSignificanceSubsystem.h"
+#include "RPGPlugin.h"
+#include "GameFramework/Actor.h"
+#include "GameFramework/PlayerController.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/App.h"
+
+DECLARE_CYCLE_STAT(TEXT("Significance Update"), STAT_SignificanceUpdate, STATGROUP_RPGPlugin);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Significance Managed Actors"), STAT_SignificanceManaged, STATGROUP_RPGPlugin);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Significance Full Rate"), STAT_SignificanceFullRate, STATGROUP_RPGPlugin);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Significance Reduced Rate"), STAT_SignificanceReducedRate, STATGROUP_RPGPlugin);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Significance Tick Off"), STAT_SignificanceTickOff, STATGROUP_RPGPlugin);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Significance Ticked This Frame"), STAT_SignificanceTicked, STATGROUP_RPGPlugin);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Significance Skipped This Frame"), STAT_SignificanceSkipped, STATGROUP_RPGPlugin);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Significance Avg Tick (us)"), STAT_SignificanceAvgTick, STATGROUP_RPGPlugin);
+
+static TAutoConsoleVariable<float> CVarSignificanceTickBudgetMs(
+	TEXT("rpg.Significance.TickBudgetMs"),
+	2.0f,
+	TEXT("Game thread time per frame the actors managed by the significance subsystem can spend ticking, in milliseconds."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarSignificanceUpdateInterval(
+	TEXT("rpg.Significance.UpdateInterval"),
+	0.25f,
+	TEXT("Seconds between significance updates."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarSignificanceNearDistance(
+	TEXT("rpg.Significance.NearDistance"),
+	3000.0f,
+	TEXT("Actors rendered and closer than this to a local player can tick every frame."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarSignificanceCullDistance(
+	TEXT("rpg.Significance.CullDistance"),
+	15000.0f,
+	TEXT("Actors not rendered and farther than this from every local player don't tick."),
+	ECVF_Default);
+
+
+void UTickSignificanceSubsystem::Deinitialize()
+{
+	Actors.Empty();
+	ActorIndices.Empty();
+
+	SET_DWORD_STAT(STAT_SignificanceManaged, 0);
+
+	Super::Deinitialize();
+}
+
+TStatId UTickSignificanceSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UTickSignificanceSubsystem, STATGROUP_Tickables);
+}
+
+void UTickSignificanceSubsystem::RegisterActor(AActor* Actor)
+{
+	if ((Actor == nullptr) || ActorIndices.Contains(Actor)) return;
+
+	// Keeps its current tick until the next update
+	FManagedActor& Managed = Actors.AddDefaulted_GetRef();
+	Managed.Actor = Actor;
+
+	ActorIndices.Add(Actor, Actors.Num() - 1);
+
+	SET_DWORD_STAT(STAT_SignificanceManaged, Actors.Num());
+}
+
+void UTickSignificanceSubsystem::UnregisterActor(AActor* Actor)
+{
+	int32 Index = INDEX_NONE;
+
+	if (!ActorIndices.RemoveAndCopyValue(Actor, Index)) return;
+
+	Actors.RemoveAtSwap(Index);
+
+	if (Actors.IsValidIndex(Index))
+	{
+		ActorIndices.Add(Actors[Index].Actor.Get(), Index);
+	}
+
+	SET_DWORD_STAT(STAT_SignificanceManaged, Actors.Num());
+}
+
+void UTickSignificanceSubsystem::ReportTick(uint32 Cycles)
+{
+	TicksThisFrame++;
+
+	// Slow moving average, a single hitch should not turn every actor off
+	AverageTickSeconds += (FPlatformTime::ToSeconds(Cycles) - AverageTickSeconds) * 0.01;
+}
+
+void UTickSignificanceSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	// Ticks reported since the last frame, the subsystem ticks once per frame
+	SET_DWORD_STAT(STAT_SignificanceTicked, TicksThisFrame);
+	SET_DWORD_STAT(STAT_SignificanceSkipped, FMath::Max(Actors.Num() - TicksThisFrame, 0));
+	TicksThisFrame = 0;
+
+	TimeSinceUpdate += DeltaTime;
+
+	if (TimeSinceUpdate < CVarSignificanceUpdateInterval.GetValueOnGameThread())
+	{
+		return;
+	}
+
+	TimeSinceUpdate = 0.0f;
+
+	UpdateSignificance();
+}
+
+void UTickSignificanceSubsystem::UpdateSignificance()
+{
+	SCOPE_CYCLE_COUNTER(STAT_SignificanceUpdate);
+
+	ViewLocations.Reset();
+
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		APlayerController* PlayerController = It->Get();
+
+		if ((PlayerController != nullptr) && PlayerController->IsLocalController())
+		{
+			FVector ViewLocation;
+			FRotator ViewRotation;
+			PlayerController->GetPlayerViewPoint(ViewLocation, ViewRotation);
+
+			ViewLocations.Add(ViewLocation);
+		}
+	}
+
+	// Nobody to look at them, leave the actors as they are
+	if (ViewLocations.Num() == 0) return;
+
+	const float NearDistanceSquared = FMath::Square(CVarSignificanceNearDistance.GetValueOnGameThread());
+	const float CullDistanceSquared = FMath::Square(CVarSignificanceCullDistance.GetValueOnGameThread());
+
+	//// Significance: what each actor could get without a budget ///////
+	SortedIndices.Reset(Actors.Num());
+
+	for (int32 Index = 0; Index < Actors.Num(); Index++)
+	{
+		FManagedActor& Managed = Actors[Index];
+		const AActor* Actor = Managed.Actor.Get();
+
+		if (Actor == nullptr) continue;
+
+		const FVector Location = Actor->GetActorLocation();
+		float DistanceSquared = MAX_flt;
+
+		for (const FVector& ViewLocation : ViewLocations)
+		{
+			DistanceSquared = FMath::Min(DistanceSquared, FVector::DistSquared(Location, ViewLocation));
+		}
+
+		const bool bRendered = Actor->WasRecentlyRendered(0.2f);
+		const bool bNear = (DistanceSquared <= NearDistanceSquared);
+
+		if (bRendered && bNear)
+		{
+			Managed.BestTier = ETickTier::Full;
+		}
+		else if (bRendered || bNear)
+		{
+			Managed.BestTier = ETickTier::Reduced;
+		}
+		else if (DistanceSquared <= CullDistanceSquared)
+		{
+			Managed.BestTier = ETickTier::Minimal;
+		}
+		else
+		{
+			Managed.BestTier = ETickTier::Off;
+		}
+
+		Managed.Score = (bRendered ? 2.0f : 1.0f) / (1.0f + FMath::Sqrt(DistanceSquared) / 1000.0f);
+
+		SortedIndices.Add(Index);
+	}
+
+	SortedIndices.Sort([this](int32 A, int32 B) { return Actors[A].Score > Actors[B].Score; });
+
+	//// Budget: the most significant actors get served first ///////
+	const double FrameSeconds = FMath::Max(FApp::GetDeltaTime(), 1.0 / 120.0);
+	double RemainingSeconds = CVarSignificanceTickBudgetMs.GetValueOnGameThread() / 1000.0;
+
+	int32 NumFull = 0;
+	int32 NumReduced = 0;
+	int32 NumOff = 0;
+
+	for (int32 Index : SortedIndices)
+	{
+		FManagedActor& Managed = Actors[Index];
+		ETickTier Tier = ETickTier::Off;
+
+		for (uint8 Candidate = static_cast<uint8>(Managed.BestTier); Candidate < static_cast<uint8>(ETickTier::Off); Candidate++)
+		{
+			// Ticks per frame at this rate, times the cost of one tick
+			const float Interval = GetTierInterval(static_cast<ETickTier>(Candidate));
+			const double Cost = AverageTickSeconds * ((Interval > 0.0f) ? FMath::Min(FrameSeconds / Interval, 1.0) : 1.0);
+
+			if (Cost <= RemainingSeconds)
+			{
+				Tier = static_cast<ETickTier>(Candidate);
+				RemainingSeconds -= Cost;
+				break;
+			}
+		}
+
+		if (Tier != Managed.Tier)
+		{
+			Managed.Tier = Tier;
+			ApplyTier(Managed.Actor.Get(), Tier);
+		}
+
+		switch (Tier)
+		{
+		case ETickTier::Full: NumFull++; break;
+		case ETickTier::Off: NumOff++; break;
+		default: NumReduced++; break;
+		}
+	}
+
+	SET_DWORD_STAT(STAT_SignificanceFullRate, NumFull);
+	SET_DWORD_STAT(STAT_SignificanceReducedRate, NumReduced);
+	SET_DWORD_STAT(STAT_SignificanceTickOff, NumOff);
+	SET_FLOAT_STAT(STAT_SignificanceAvgTick, AverageTickSeconds * 1000000.0);
+}
+
+float UTickSignificanceSubsystem::GetTierInterval(ETickTier Tier)
+{
+	switch (Tier)
+	{
+	case ETickTier::Reduced: return 0.1f;
+	case ETickTier::Minimal: return 0.5f;
+	default: return 0.0f;
+	}
+}
+
+void UTickSignificanceSubsystem::ApplyTier(AActor* Actor, ETickTier Tier)
+{
+	if (Actor == nullptr) return;
+
+	if (Tier == ETickTier::Off)
+	{
+		Actor->SetActorTickEnabled(false);
+		return;
+	}
+
+	Actor->SetActorTickInterval(GetTierInterval(Tier));
+	Actor->SetActorTickEnabled(true);
+}
@@ -0,0 +1,105 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "TickSignificanceSubsystem.generated.h"
+
+/**
+ * Decides how often the registered actors (enemies, weapons, chests) tick.
+ * Every rpg.Significance.UpdateInterval the actors are scored by distance to the nearest local player view and by
+ * whether they were rendered, then walked from the most significant down: each one gets the fastest tick rate that
+ * its significance allows and that still fits in rpg.Significance.TickBudgetMs. Actors out of budget or far away
+ * don't tick at all. The tick cost comes from the actors themselves, see FSignificanceTickScope.
+ */
+UCLASS()
+class RPGPLUGIN_API UTickSignificanceSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+
+	virtual void Deinitialize() override;
+
+	virtual void Tick(float DeltaTime) override;
+
+	virtual TStatId GetStatId() const override;
+
+	// The tick of the actor is managed from now on, until it is unregistered
+	void RegisterActor(AActor* Actor);
+
+	void UnregisterActor(AActor* Actor);
+
+	// Time spent in one tick of a registered actor
+	void ReportTick(uint32 Cycles);
+
+	// Scores and assigns the tick rates now instead of on the next interval
+	void UpdateSignificance();
+
+protected:
+
+	enum class ETickTier : uint8
+	{
+		Full,		// Every frame
+		Reduced,	// A few times per second
+		Minimal,	// About twice per second
+		Off,
+	};
+
+	static float GetTierInterval(ETickTier Tier);
+
+	void ApplyTier(AActor* Actor, ETickTier Tier);
+
+	struct FManagedActor
+	{
+		TWeakObjectPtr<AActor> Actor;
+
+		float Score = 0.0f;
+
+		// Fastest tier the significance allows, the budget may give a slower one
+		ETickTier BestTier = ETickTier::Full;
+
+		ETickTier Tier = ETickTier::Full;
+	};
+
+	TArray<FManagedActor> Actors;
+
+	TMap<const AActor*, int32> ActorIndices;
+
+	// Reused between updates
+	TArray<int32> SortedIndices;
+
+	TArray<FVector> ViewLocations;
+
+	float TimeSinceUpdate = 0.0f;
+
+	// Average of the reported ticks
+	double AverageTickSeconds = 20.0e-6;
+
+	int32 TicksThisFrame = 0;
+};
+
+// Measures the tick of a registered actor for the budget, Blueprint ticks included
+struct RPGPLUGIN_API FSignificanceTickScope
+{
+	explicit FSignificanceTickScope(UTickSignificanceSubsystem* InSubsystem)
+		: Subsystem(InSubsystem)
+		, StartCycles(FPlatformTime::Cycles())
+	{
+	}
+
+	~FSignificanceTickScope()
+	{
+		if (Subsystem != nullptr)
+		{
+			Subsystem->ReportTick(FPlatformTime::Cycles() - StartCycles);
+		}
+	}
+
+private:
+
+	UTickSignificanceSubsystem* Subsystem;
+
+	uint32 StartCycles;
+};
@@ -0,0 +1,126 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "WorldStateSubsystem.h"
+#include "RPGPluginGameInstance.h"
+#include "SaveJournal.h"
+#include "GameFramework/Actor.h"
+#include "Engine/World.h"
+
+void UWorldStateSubsystem::Deinitialize()
+{
+	IDToIndex.Empty();
+	IDs.Empty();
+	Flags.Empty();
+	DirtyFlags.Empty();
+	DirtyIndices.Empty();
+
+	Super::Deinitialize();
+}
+
+FName UWorldStateSubsystem::MakeStableID(const AActor* Actor)
+{
+	// Spawned actors get a different name every run, only actors placed on a level can be tracked
+	if ((Actor == nullptr) || !Actor->IsNetStartupActor())
+	{
+		return NAME_None;
+	}
+
+	return FName(*UWorld::RemovePIEPrefix(Actor->GetPathName()));
+}
+
+int32 UWorldStateSubsystem::RegisterActor(const AActor* Actor)
+{
+	const FName ID = MakeStableID(Actor);
+
+	return (ID != NAME_None) ? FindOrAddIndex(ID) : INDEX_NONE;
+}
+
+void UWorldStateSubsystem::SetFlag(int32 Index, bool bValue)
+{
+	if (!Flags.IsValidIndex(Index) || (Flags[Index] == bValue)) return;
+
+	Flags[Index] = bValue;
+
+	if (!DirtyFlags[Index])
+	{
+		DirtyFlags[Index] = true;
+		DirtyIndices.Add(Index);
+	}
+}
+
+void UWorldStateSubsystem::ReadFrom(const UMainSaveGame& SaveGame)
+{
+	ClearFlags();
+
+	for (int i = 0; i < SaveGame.WorldStateIDs.Num(); i++)
+	{
+		if (SaveGame.GetWorldStateFlag(i))
+		{
+			Flags[FindOrAddIndex(SaveGame.WorldStateIDs[i])] = true;
+		}
+	}
+
+	OnWorldStateLoaded.Broadcast();
+}
+
+void UWorldStateSubsystem::Reset()
+{
+	ClearFlags();
+
+	OnWorldStateLoaded.Broadcast();
+}
+
+void UWorldStateSubsystem::ClearFlags()
+{
+	// Registered actors keep their index, only the values go
+	Flags.Init(false, IDs.Num());
+	DirtyFlags.Init(false, IDs.Num());
+	DirtyIndices.Reset();
+
+	bLoaded = true;
+}
+
+void UWorldStateSubsystem::ConsumeDirty(TArray<FSaveJournalRecord>& OutRecords)
+{
+	for (int32 Index : DirtyIndices)
+	{
+		OutRecords.Add(FSaveJournalRecord::MakeWorldState(IDs[Index], Flags[Index]));
+		DirtyFlags[Index] = false;
+	}
+
+	DirtyIndices.Reset();
+}
+
+void UWorldStateSubsystem::RestoreFlags(const TBitArray<>& SavedFlags)
+{
+	for (int32 Index = 0; Index < Flags.Num(); Index++)
+	{
+		// Actors registered after the copy had no flag set back then
+		Flags[Index] = SavedFlags.IsValidIndex(Index) && SavedFlags[Index];
+	}
+
+	for (int32 Index : DirtyIndices)
+	{
+		DirtyFlags[Index] = false;
+	}
+
+	DirtyIndices.Reset();
+
+	OnWorldStateLoaded.Broadcast();
+}
+
+int32 UWorldStateSubsystem::FindOrAddIndex(FName ID)
+{
+	if (const int32* Index = IDToIndex.Find(ID))
+	{
+		return *Index;
+	}
+
+	const int32 Index = IDs.Add(ID);
+	IDToIndex.Add(ID, Index);
+	Flags.Add(false);
+	DirtyFlags.Add(false);
+
+	return Index;
+}
@@ -0,0 +1,78 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/GameInstanceSubsystem.h"
+#include "WorldStateSubsystem.generated.h"
+
+class UMainSaveGame;
+struct FSaveJournalRecord;
+
+DECLARE_MULTICAST_DELEGATE(FOnWorldStateLoadedDelegate);
+
+/**
+ * One persistent flag per level actor (item collected, chest completed...).
+ * Actors are identified by their path without the PIE prefix, so the same actor gets the same flag
+ * after a reload or when its level is streamed in again. Flags live in a bitset indexed by registration order,
+ * the save only keeps the IDs with their bits.
+ */
+UCLASS()
+class RPGPLUGIN_API UWorldStateSubsystem : public UGameInstanceSubsystem
+{
+	GENERATED_BODY()
+
+public:
+
+	virtual void Deinitialize() override;
+
+	// Index of the flag of the actor, INDEX_NONE for actors spawned at runtime
+	int32 RegisterActor(const AActor* Actor);
+
+	static FName MakeStableID(const AActor* Actor);
+
+	bool GetFlag(int32 Index) const { return Flags.IsValidIndex(Index) && Flags[Index]; }
+
+	void SetFlag(int32 Index, bool bValue);
+
+	//// Save ///////
+
+	// False until a save (or a new game) has been applied, flags read before that are not final
+	bool IsLoaded() const { return bLoaded; }
+
+	// Broadcast when the flags are replaced by the ones of a save
+	FOnWorldStateLoadedDelegate OnWorldStateLoaded;
+
+	void ReadFrom(const UMainSaveGame& SaveGame);
+
+	// Clears every flag for new games, also broadcasts OnWorldStateLoaded
+	void Reset();
+
+	// Flags changed since the last call, for the save journal
+	void ConsumeDirty(TArray<FSaveJournalRecord>& OutRecords);
+
+	//// Checkpoint respawn ///////
+
+	void CopyFlags(TBitArray<>& OutFlags) const { OutFlags = Flags; }
+
+	// Flags copied on the last checkpoint, when the journal got the same values. Broadcasts OnWorldStateLoaded
+	void RestoreFlags(const TBitArray<>& SavedFlags);
+
+protected:
+
+	int32 FindOrAddIndex(FName ID);
+
+	void ClearFlags();
+
+	TMap<FName, int32> IDToIndex;
+
+	TArray<FName> IDs;
+
+	TBitArray<> Flags;
+
+	TBitArray<> DirtyFlags;
+
+	TArray<int32> DirtyIndices;
+
+	bool bLoaded = false;
+};